@@ -0,0 +1,184 @@
+/*
+ * bench.c
+ *
+ * Created: Jan 2022
+ * Author: Arjan te Marvelde
+ *
+ * Benchmark firmware, a separate target (uWFG_bench) on the same generator, synthesis and display code.
+ *
+ * After the USB port is opened, a fixed matrix is run on channel A and the results are printed as CSV, one table
+ * per section, each preceded by a header line. The system clock is BENCH_KHZ, so builds and clock settings can be
+ * compared by diffing the output.
+ * - synth:   cycles of synth_wave() for each waveform mode and buffer length
+ * - play:    cycles of gen_play() for each mode, length and PIO divider, i.e. the reconfiguration latency including
+ *            the wait for a safe swap, and whether the output stalled over BENCH_MS thereafter
+ * - maxrate: for each buffer length, the smallest divider in 1/16 steps that plays without stalls, and its rate
+ * - lcd:     cycles to draw a full screen of text, and the time of the DMA flush to the display
+ * Cycles are counted with SysTick, see stats.c. The lengths go from GEN_MINBUFLEN to GEN_MAXBUFLEN, with both
+ * power of two (read ring) and other lengths.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "pico/stdio_usb.h"
+#include "hardware/i2c.h"
+#include "hardware/gpio.h"
+
+#include "gen.h"
+#include "hmi.h"
+#include "synth.h"
+#include "lcd.h"
+#include "stats.h"
+
+#ifndef BENCH_KHZ
+#define BENCH_KHZ		125000												// System clock, override with -DBENCH_KHZ
+#endif
+#define BENCH_MS		20													// Stall observation time per point [msec]
+#define BENCH_NLEN		(1+2*7)												// GEN_MINBUFLEN, then 3/4*2^i and 2^i for 32..2048
+#define BENCH_NDIV		5
+#define BENCH_MAXDIV	4.0													// Maximum divider searched in maxrate
+
+#define I2C0_SDA		16
+#define I2C0_SCL		17
+
+static const float bench_div[BENCH_NDIV] = {1.0, 1.5, 2.0, 4.0, 16.0};
+static const char *bench_mode[HMI_NMODE] = {"sqr", "tri", "saw", "sin", "pul"};
+uint32_t bench_len[BENCH_NLEN];
+uint8_t  bench_buf[GEN_MAXBUFLEN] __attribute__((aligned(4)));
+
+
+/*
+ * Buffer lengths of the matrix
+ */
+static void bench_lengths(void)
+{
+	uint32_t l;
+	int i = 0;
+
+	bench_len[i++] = GEN_MINBUFLEN;
+	for (l=32; l<=GEN_MAXBUFLEN; l*=2)
+	{
+		bench_len[i++] = 3*l/4;
+		bench_len[i++] = l;
+	}
+}
+
+/*
+ * Synthesize one period of mode into bench_buf, of exactly len samples played at divider div
+ */
+static uint32_t bench_synth(int mode, uint32_t len, float div, wfg_t *wf)
+{
+	ch_t def = {mode, 0.0, 50, 10, 10};
+	uint32_t t0, dt;
+
+	def.time = ((float)len + 0.5f) / _fsys;								// Yields len samples, see synth_wave()
+	wf->buf = bench_buf;
+	t0 = stats_begin();
+	synth_wave(&def, wf);
+	dt = stats_since(t0);
+	wf->dur = (float)wf->len * div / _fsys;
+	return dt;
+}
+
+/*
+ * Play wf on channel A, returns the gen_play() cycles, and whether the output stalled
+ */
+static uint32_t bench_play(wfg_t *wf, bool *stall)
+{
+	genhw_t hw;
+	uint32_t t0, dt;
+
+	t0 = stats_begin();
+	gen_play(OUTA, wf);
+	dt = stats_since(t0);
+	sleep_ms(2);															// Swap or restart done
+	gen_hwstat(OUTA, &hw);													// Clear stall flag
+	sleep_ms(BENCH_MS);
+	gen_hwstat(OUTA, &hw);
+	*stall = hw.stall || (hw.err != 0);
+	return dt;
+}
+
+static void bench_run(void)
+{
+	wfg_t wf;
+	uint32_t t0, dt, us;
+	float div;
+	bool stall;
+	int m, i, j;
+
+	printf("# uWFG bench, fsys=%.0f\n", _fsys);
+
+	printf("synth,mode,len,cycles\n");
+	for (m=0; m<HMI_NMODE; m++)
+		for (i=0; i<BENCH_NLEN; i++)
+		{
+			dt = bench_synth(m, bench_len[i], 1.0, &wf);
+			printf("synth,%s,%lu,%lu\n", bench_mode[m], wf.len, dt);
+		}
+
+	printf("play,mode,len,div,rate,cycles,stall\n");
+	for (m=0; m<HMI_NMODE; m++)
+		for (i=0; i<BENCH_NLEN; i++)
+			for (j=0; j<BENCH_NDIV; j++)
+			{
+				bench_synth(m, bench_len[i], bench_div[j], &wf);
+				dt = bench_play(&wf, &stall);
+				printf("play,%s,%lu,%.2f,%.0f,%lu,%d\n", bench_mode[m], wf.len, bench_div[j], gen_getrate(OUTA), dt, stall);
+			}
+
+	printf("maxrate,len,div,rate\n");
+	for (i=0; i<BENCH_NLEN; i++)
+	{
+		for (div=1.0; div<=BENCH_MAXDIV; div+=1.0/16)
+		{
+			bench_synth(HMI_SQR, bench_len[i], div, &wf);
+			bench_play(&wf, &stall);
+			if (!stall) break;
+		}
+		if (stall) printf("maxrate,%lu,>%.2f,0\n", wf.len, BENCH_MAXDIV);
+		else printf("maxrate,%lu,%.4f,%.0f\n", wf.len, div, gen_getrate(OUTA));
+	}
+
+	printf("lcd,draw_cycles,flush_us\n");
+	while (lcd_busy()) tight_loop_contents();
+	t0 = stats_begin();
+	lcd_clrscr(0, 0, LCD_WIDTH, LCD_HEIGHT);
+	for (i=0; i<LCD_HEIGHT/8; i++)
+		lcd_puts(0, 8*i, "0123456789ABCDEFGHIJK", LCD_6X8, (i&1));
+	dt = stats_since(t0);
+	us = time_us_32();
+	lcd_sync();																// All chunks of the frame
+	us = time_us_32() - us;
+	printf("lcd,%lu,%lu\n", dt, us);
+	printf("# done\n");
+}
+
+int main()
+{
+	set_sys_clock_khz(BENCH_KHZ, true);
+	sleep_ms(2);
+	stdio_init_all();
+
+	/* i2c0 initialisation at 400Khz, as in uWFG.c */
+	i2c_init(i2c0, 400*1000);
+	gpio_set_function(I2C0_SDA, GPIO_FUNC_I2C);
+	gpio_set_function(I2C0_SCL, GPIO_FUNC_I2C);
+	gpio_pull_up(I2C0_SDA);
+	gpio_pull_up(I2C0_SCL);
+
+	stats_init();
+	gen_init();
+	lcd_init();
+	lcd_sync();																// Splash, display on
+	bench_lengths();
+
+	while (true)
+	{
+		while (!stdio_usb_connected()) sleep_ms(100);						// Wait for host
+		sleep_ms(500);
+		bench_run();
+		while (stdio_usb_connected()) sleep_ms(100);						// Run again on next connect
+	}
+}
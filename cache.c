@@ -0,0 +1,96 @@
+/*
+ * cache.c
+ *
+ * Created: Jan 2022
+ * Author: Arjan te Marvelde
+ * 
+ * Cache of synthesized waveforms, used on core 1 only.
+ *
+ * When tuning, the user often toggles between a few channel settings. Instead of synthesizing the samples again
+ * and copying them into the generator buffer, a cached waveform is played from its slot by a pointer swap, 
+ * see gen_playref().
+ * A slot is keyed by the channel definition, the sample width and the system clock, and also holds the
+ * frequency plan. On a miss the least recently used slot is taken, skipping slots that are still playing.
+ */
+
+#include "pico/stdlib.h"
+
+#include "gen.h"
+#include "hmi.h"
+#include "plan.h"
+#include "cache.h"
+
+typedef struct
+{
+	bool	 valid;															// Slot contains samples
+	uint32_t last;															// Time of last use, in lookups
+	ch_t	 def;															// Key: channel definition,
+	int		 wid;															//  sample width
+	float	 fsys;															//  and system clock
+	plan_t	 plan;															// Frequency plan of the samples
+} cslot_t;
+
+uint8_t  cache_buf[CACHE_NSLOT][CACHE_SLOTLEN] __attribute__((aligned(CACHE_SLOTLEN)));	// Aligned for the DMA read ring
+cslot_t  cache_slot[CACHE_NSLOT];
+uint32_t cache_clock;														// Lookup counter, for LRU
+
+/*
+ * Compare key of slot i with def, for the current width and system clock
+ */
+static bool cache_match(int i, ch_t *def)
+{
+	cslot_t *c = &cache_slot[i];
+
+	if (!c->valid) return false;
+	if ((c->wid != gen_getwidth()) || (c->fsys != _fsys)) return false;
+	return ((c->def.mode == def->mode) && (c->def.time == def->time) && (c->def.duty == def->duty) &&
+			(c->def.rise == def->rise) && (c->def.fall == def->fall));
+}
+
+/*
+ * Lookup the waveform for def, on a hit wf and pl are filled and true is returned
+ */
+bool cache_get(ch_t *def, wfg_t *wf, plan_t *pl)
+{
+	int i;
+
+	cache_clock++;
+	for (i=0; i<CACHE_NSLOT; i++)
+	{
+		if (!cache_match(i, def)) continue;
+		cache_slot[i].last = cache_clock;
+		*pl = cache_slot[i].plan;
+		wf->buf = cache_buf[i];
+		wf->len = pl->n * gen_getwidth();
+		wf->dur = plan_dur(pl);
+		return true;
+	}
+	return false;
+}
+
+/*
+ * Take the least recently used slot that is not playing for def with plan pl, and return its sample buffer
+ * The caller must fill the buffer with synth_plan() before any other cache call.
+ * Returns NULL when the waveform is too long, or when all slots are playing.
+ */
+uint8_t *cache_new(ch_t *def, plan_t *pl)
+{
+	int i, lru = -1;
+
+	if (pl->n * gen_getwidth() > CACHE_SLOTLEN) return NULL;
+	for (i=0; i<CACHE_NSLOT; i++)
+	{
+		if (gen_inuse(cache_buf[i], CACHE_SLOTLEN)) continue;				// Still playing
+		if (!cache_slot[i].valid) { lru = i; break; }						// Empty slot
+		if ((lru < 0) || ((int32_t)(cache_slot[i].last - cache_slot[lru].last) < 0)) lru = i;
+	}
+	if (lru < 0) return NULL;
+	
+	cache_slot[lru].valid = true;
+	cache_slot[lru].last = cache_clock;
+	cache_slot[lru].def = *def;
+	cache_slot[lru].wid = gen_getwidth();
+	cache_slot[lru].fsys = _fsys;
+	cache_slot[lru].plan = *pl;
+	return cache_buf[lru];
+}
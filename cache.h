@@ -0,0 +1,25 @@
+#ifndef __CACHE_H__
+#define __CACHE_H__
+/* 
+ * cache.h
+ *
+ * Created: Jan 2022
+ * Author: Arjan te Marvelde
+ *
+ * See cache.c for more information 
+ */
+
+#include "gen.h"
+#include "hmi.h"
+#include "plan.h"
+
+#define CACHE_NSLOT		4													// Nr of cached waveforms
+#define CACHE_SLOTLEN	GEN_MAXBUFLEN										// Maximum cached waveform length in bytes
+
+/* Lookup, on a hit wf and pl are filled from the slot */
+bool cache_get(ch_t *def, wfg_t *wf, plan_t *pl);
+
+/* Take a slot for def with plan pl, returns the sample buffer or NULL when it cannot be cached */
+uint8_t *cache_new(ch_t *def, plan_t *pl);
+
+#endif
@@ -0,0 +1,82 @@
+/*
+ * cal.c
+ *
+ * Created: Jan 2022
+ * Author: Arjan te Marvelde
+ *
+ * Calibration of the R-2R ladder DACs.
+ *
+ * Resistor tolerances make the steps of each ladder unequal, at the major code transitions (e.g. 0x7f to 0x80) the
+ * output may even go down. A correction table per channel maps each sample value to the code of which the output
+ * is closest to the ideal straight line between code 0x00 and 0xff. The generator applies it when samples are taken
+ * over, see gen_setcal(), so playback is not affected.
+ *
+ * A table is either uploaded (monitor cal load), or measured here on ADC0: the generator side of the LCR meter
+ * reference resistor, see lcr.c, which is channel A. Channel B can be measured when its output is wired to that
+ * input instead. Each code is played as a DC buffer with CORE1_DAC, so without the present correction, and after
+ * settling the average of CAL_NAVG conversions is taken. The ADC has 12 bits but its own non-linearity, so an
+ * uploaded table made with a proper meter is more accurate.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "pico/stdlib.h"
+
+#include "gen.h"
+#include "core1.h"
+#include "lcr.h"
+#include "cal.h"
+
+uint8_t cal_dc[CAL_DCLEN] __attribute__((aligned(4)));						// DC samples
+
+
+/*
+ * For each sample value, the code with the output nearest to the straight line from v[0] to v[255]
+ */
+bool cal_build(const float *v, uint8_t *lut)
+{
+	float t, d, best;
+	int i, c;
+
+	if (v[GEN_CALLEN-1] <= v[0]) return false;								// Not connected
+	for (i=0; i<GEN_CALLEN; i++)
+	{
+		t = v[0] + (v[GEN_CALLEN-1] - v[0]) * i / (GEN_CALLEN-1);			// Ideal level
+		best = INFINITY;
+		for (c=0; c<GEN_CALLEN; c++)
+		{
+			d = fabsf(v[c] - t);
+			if (d < best) { best = d; lut[i] = c; }
+		}
+	}
+	return true;
+}
+
+/*
+ * Measure each code of channel ch on ADC0 and build the table, the channel plays the last DC level afterwards
+ */
+bool cal_measure(int ch, uint8_t *lut)
+{
+	static float v[GEN_CALLEN];
+	c1cmd_t cmd;
+	int c;
+
+	if (gen_getwidth() != GEN_WIDTH8) return false;
+	cmd.cmd = CORE1_DAC;
+	cmd.ch = ch;
+	cmd.wave.buf = cal_dc;
+	cmd.wave.len = CAL_DCLEN;
+	cmd.wave.dur = CAL_DCLEN * 1.0e-6;
+	for (c=0; c<GEN_CALLEN; c++)
+	{
+		core1_sync();														// Previous level copied
+		memset(cal_dc, c, CAL_DCLEN);
+		core1_post(&cmd);
+		core1_sync();
+		sleep_us(CAL_SETTLE);
+		v[c] = lcr_dc(CAL_NAVG);
+		if (v[c] < 0.0) return false;										// LCR capture busy
+	}
+	return cal_build(v, lut);
+}
@@ -0,0 +1,24 @@
+#ifndef __CAL_H__
+#define __CAL_H__
+/*
+ * cal.h
+ *
+ * Created: Jan 2022
+ * Author: Arjan te Marvelde
+ *
+ * See cal.c for more information
+ */
+
+#include "gen.h"
+
+#define CAL_DCLEN		GEN_MINBUFLEN										// DC buffer, no read ring so it swaps per period
+#define CAL_SETTLE		100													// Settling time per code [usec]
+#define CAL_NAVG		64													// ADC conversions per code
+
+/* Build a correction table from the output voltage v[] measured for each code, false when v is not increasing */
+bool cal_build(const float *v, uint8_t *lut);
+
+/* Measure the output of a channel on ADC0 for each code, and build its table, call on core 0 */
+bool cal_measure(int ch, uint8_t *lut);
+
+#endif
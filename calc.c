@@ -0,0 +1,84 @@
+/*
+ * calc.c
+ *
+ * Created: Jan 2022
+ * Author: Arjan te Marvelde
+ *
+ * Generator arithmetic, without any hardware access.
+ *
+ * The conversions between sample rates and PIO clock divider register values, and the system clock frequency
+ * that follows from the PLL settings, are kept here so they give the same results on the Pico and on a host.
+ * gen.c applies them to the registers, see also the host tool in the host directory.
+ *
+ * The PIO clock divider register has the integer part in bits 31:16 and the fraction in 1/256 in bits 15:8.
+ * The system PLL runs a VCO at XOSC*fbdiv, which is divided by pd1*pd2 into the system clock.
+ */
+
+#include "calc.h"
+
+#define CALC_VCOMIN		750000												// VCO range [kHz], as in the SDK
+#define CALC_VCOMAX		1600000
+
+
+/*
+ * Convert a sample clock to fsys ratio into PIO clock divider register format
+ * The ratio is a double: a float has only 8 fraction bits left above 32768, too few to round to 1/256.
+ */
+uint32_t calc_clkdiv(double div)
+{
+	uint32_t clkdiv;														// 31:16 int part, 15:8 frac part (in 1/256)
+
+	if (div < 1.0) div=1.0; 												// Sample rate too high: top off
+	if (div > 65535.0) div=65535.0;											// Sample rate too low: bottom off
+	clkdiv = (uint32_t)(div*256 + 0.5);										// Round to nearest 1/256
+	clkdiv = clkdiv << 8;													// Final shift to match required format
+	return clkdiv;
+}
+
+/*
+ * Ratio of fsys to sample clock for a divider register value
+ */
+float calc_divval(uint32_t clkdiv)
+{
+	return (float)(clkdiv >> 8) / 256.0;									// Int and frac part in 1/256
+}
+
+/*
+ * Divider register value for n samples in dur [s], in double so integer plan dividers come out exact
+ */
+uint32_t calc_playdiv(double fsys, double dur, uint32_t n)
+{
+	return calc_clkdiv(fsys * dur / n);										// Sample rate to fsys ratio
+}
+
+float calc_fsys(uint32_t fbdiv, uint32_t pd1, uint32_t pd2)
+{
+	float f = CALC_XOSC;
+
+	f *= fbdiv&0xfff;														// Feedback divider
+	f /= pd1;																// Post divider 1
+	f /= pd2;																// Post divider 2
+	return f;
+}
+
+/*
+ * Same search as check_sys_clock_khz() in the SDK: highest VCO first, then the larger post dividers
+ */
+bool calc_pll(uint32_t khz, uint32_t *fbdiv, uint32_t *pd1, uint32_t *pd2)
+{
+	uint32_t fb, p1, p2, vco, ref = (uint32_t)(CALC_XOSC/1000);
+
+	for (fb=320; fb>=16; fb--)
+	{
+		vco = fb * ref;
+		if ((vco < CALC_VCOMIN) || (vco > CALC_VCOMAX)) continue;
+		for (p1=7; p1>=1; p1--)
+			for (p2=p1; p2>=1; p2--)
+				if (vco == khz * p1 * p2)
+				{
+					*fbdiv = fb; *pd1 = p1; *pd2 = p2;
+					return true;
+				}
+	}
+	return false;
+}
@@ -0,0 +1,30 @@
+#ifndef __CALC_H__
+#define __CALC_H__
+/*
+ * calc.h
+ *
+ * Created: Jan 2022
+ * Author: Arjan te Marvelde
+ *
+ * See calc.c for more information
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define CALC_XOSC		12.0e6												// Crystal oscillator [Hz]
+
+/* PIO clock divider register value for a ratio of fsys to sample clock, and back */
+uint32_t calc_clkdiv(double div);
+float calc_divval(uint32_t clkdiv);
+
+/* Divider register value for n samples in dur [s], as used by gen_play() */
+uint32_t calc_playdiv(double fsys, double dur, uint32_t n);
+
+/* System clock from the PLL feedback divider and the two post dividers */
+float calc_fsys(uint32_t fbdiv, uint32_t pd1, uint32_t pd2);
+
+/* Find PLL settings for exactly khz [kHz], returns false when there are none */
+bool calc_pll(uint32_t khz, uint32_t *fbdiv, uint32_t *pd1, uint32_t *pd2);
+
+#endif
@@ -0,0 +1,417 @@
+/*
+ * core1.c
+ *
+ * Created: Jan 2022
+ * Author: Arjan te Marvelde
+ * 
+ * The generator service, running on core 1.
+ *
+ * Core 1 owns waveform synthesis and the reprogramming of the generator PIO and DMA, so the latency of output
+ * reconfiguration does not depend on the (slow, blocking) keypad and display I/O handled by core 0.
+ * The HMI and the monitor post commands into a lock-free single producer / single consumer queue: 
+ * core 0 only writes the head index, core 1 only writes the tail index.
+ * After posting, core 0 pushes a doorbell word into the SIO FIFO to wake up core 1, which then executes all
+ * commands in the queue.
+ * While DDS or modulation is active, core 1 does not block on the doorbell but keeps on filling the DDS stream 
+ * blocks and updating the modulated buffers.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "pico/stdlib.h"
+#include "pico/multicore.h"
+#include "hardware/sync.h"
+
+#include "gen.h"
+#include "hmi.h"
+#include "synth.h"
+#include "plan.h"
+#include "cache.h"
+#include "dds.h"
+#include "mod.h"
+#include "stats.h"
+#include "core1.h"
+
+#define CORE1_NCMD		8													// Queue depth
+
+c1cmd_t core1_cmd[CORE1_NCMD];												// Command queue
+volatile uint32_t core1_head;												// Nr of commands posted, written by core 0
+volatile uint32_t core1_tail;												// Nr of commands executed, written by core 1
+volatile bool core1_hold;													// Keep core 1 parked, written by core 0
+volatile bool core1_parked;													// Core 1 is parked, written by core 1
+
+ch_t core1_def[GEN_NCH] = 													// Last channel definitions, initially
+{																			//  similar to the gen_init() waveforms,
+	{HMI_SQR, 1.0e-6, 50,  1,  1},											//  further channels see core1_init()
+	{HMI_TRI, 1.0e-6, 50, 50, 50}
+};
+plan_t core1_plan[GEN_NCH];													// Last frequency plans
+bool core1_arb[GEN_NCH];													// Channel plays loaded samples, not core1_def
+bool core1_ok;																// Last sequence, sweep or modulation was accepted
+uint32_t core1_swtab[GEN_NCH][GEN_MAXSWEEP];								// Sweep divider tables
+
+/*
+ * Plan and synthesize waveform from channel definition, with at most maxper periods in the buffer
+ * The samples are written in place, in the generator buffer that gen_play() will use.
+ * Returns false when the channel is not available.
+ */
+static bool core1_synth(int ch, ch_t *def, uint32_t maxper, wfg_t *wf)
+{
+	core1_def[ch] = *def;
+	wf->buf = gen_loadbuf(ch);
+	if (wf->buf == NULL) return false;
+	plan_find(1.0/def->time, PLAN_NMIN, maxper, PLAN_TOL, &core1_plan[ch]);
+	synth_plan(def, wf, &core1_plan[ch]);
+	return true;
+}
+
+/*
+ * Synthesize waveform from channel definition and play it
+ * A cached waveform is played by reference, otherwise it is synthesized into a new cache slot.
+ * When it cannot be cached, it is synthesized in place into the generator buffer.
+ */
+void core1_genwave(int ch, ch_t *def)
+{
+	wfg_t wf;
+	plan_t *pl = &core1_plan[ch];
+	uint32_t t0;
+	
+	core1_def[ch] = *def;
+	if ((ch != OUTA) && (gen_getwidth() == GEN_WIDTH16)) return;			// Channel not available
+	t0 = stats_begin();
+	if (cache_get(def, &wf, pl))											// Hit: pointer swap
+	{
+		gen_playref(ch, &wf);
+		stats_end(STATS_GENWAVE, t0);
+		return;
+	}
+	plan_find(1.0/def->time, PLAN_NMIN, PLAN_MAXPER, PLAN_TOL, pl);
+	wf.buf = cache_new(def, pl);
+	if (wf.buf != NULL)														// Synthesize into cache slot
+	{
+		synth_plan(def, &wf, pl);
+		gen_playref(ch, &wf);
+	}
+	else if ((wf.buf = gen_loadbuf(ch)) != NULL)							// Too long, or all slots playing
+	{
+		synth_plan(def, &wf, pl);
+		gen_play(ch, &wf);
+	}
+	stats_end(STATS_GENWAVE, t0);
+}
+
+/*
+ * Synthesize the last channel definitions, and play them in sync, with channel B lagging phase degrees
+ * The phase shift is taken from the buffer length, so each buffer holds one period.
+ */
+void core1_gensync(float phase)
+{
+	wfg_t wf[GEN_NCH];
+	wfg_t *wave[GEN_NCH];
+	float lag[GEN_NCH];
+	int ch;
+	
+	for (ch=0; ch<GEN_NCH; ch++)
+		if (!gen_alloc(ch, 0)) return;										// All channels must have their pair
+	for (ch=0; ch<GEN_NCH; ch++)
+	{
+		dds_stop(ch);
+		mod_stop(ch);
+		core1_arb[ch] = false;
+		if (!core1_synth(ch, &core1_def[ch], 1, &wf[ch])) return;
+		wave[ch] = &wf[ch];
+		lag[ch] = (ch == OUTB) ? phase : 0.0;
+	}
+	gen_playsync(wave, lag);
+}
+
+/*
+ * Synthesize the segments of a sequence into the channel buffers, and play them
+ * The buffers are divided over the segments, each gets an exact frequency plan of one period that fits.
+ * All plans are made and checked first, so a sequence that cannot be played leaves the channel as it was.
+ */
+bool core1_genseq(int ch, c1seg_t *sq, int nseg, bool loop)
+{
+	seg_t seg[GEN_MAXSEG];
+	plan_t pl[GEN_MAXSEG];
+	uint8_t *buf;
+	uint32_t used, room;
+	int i;
+
+	if ((nseg < 1) || (nseg > GEN_MAXSEG)) return false;
+	if (gen_getwidth() == GEN_WIDTH16) return false;						// Sequences are 8 bit only
+	buf = gen_seqbuf(ch);
+	if (buf == NULL) return false;
+	used = 0;
+	for (i=0; i<nseg; i++)
+	{
+		room = ((2*gen_maxlen() - used) / (nseg - i)) & ~3;					// Fair share of what is left
+		plan_fit(1.0/sq[i].def.time, PLAN_NMIN, room, 1, PLAN_TOL, &pl[i]);
+		if (pl[i].n*gen_getwidth() > room) return false;					// Too many segments
+		seg[i].wave.buf = &buf[used];
+		seg[i].wave.len = pl[i].n*gen_getwidth();							// As synth_plan() will set
+		seg[i].wave.dur = plan_dur(&pl[i]);
+		seg[i].n = sq[i].n;
+		used += seg[i].wave.len;
+	}
+	if (!gen_seqhold(ch, seg, nseg, loop)) return false;					// Still playing the previous output
+	for (i=0; i<nseg; i++)
+		synth_plan(&sq[i].def, &seg[i].wave, &pl[i]);
+	return gen_seq(ch, seg, nseg, loop);
+}
+
+/*
+ * Sweep the frequency of the last channel definition
+ * One period is synthesized for the highest frequency, so the sweep only changes the PIO divider.
+ * The lowest frequency is limited by the maximum divider, fsys/(65535*k).
+ */
+bool core1_gensweep(int ch, c1sweep_t *sw)
+{
+	ch_t def;
+	wfg_t wf;
+	double f;
+	uint32_t i, d;
+
+	if ((sw->n < 2) || (sw->n > GEN_MAXSWEEP) || (sw->f0 <= 0.0) || (sw->f1 <= 0.0)) return false;
+	if ((sw->dwell <= 0.0) || (sw->dwell > gen_maxdwell())) return false;	// Before the waveform is changed
+	def = core1_def[ch];
+	def.time = (float)(1.0 / ((sw->f0 > sw->f1) ? sw->f0 : sw->f1));
+	if (!core1_synth(ch, &def, 1, &wf)) return false;
+	gen_play(ch, &wf);
+	for (i=0; i<sw->n; i++)
+	{
+		if (sw->log)
+			f = sw->f0 * pow(sw->f1/sw->f0, (double)i/(sw->n-1));
+		else
+			f = sw->f0 + (sw->f1 - sw->f0) * i/(sw->n-1);
+		d = (uint32_t)(_fsys * 256.0 / (f * core1_plan[ch].k) + 0.5);		// Divider in 1/256
+		if (d < (1U<<8)) d = 1U<<8;
+		if (d > (65535U<<8)) d = 65535U<<8;
+		core1_swtab[ch][i] = d << 8;										// Register format
+	}
+	return gen_sweep(ch, core1_swtab[ch], sw->n, sw->dwell);
+}
+
+/*
+ * Switch output width, and synthesize the last channel definitions in the new sample format
+ */
+void core1_genwidth(int width)
+{
+	int ch;
+	
+	for (ch=0; ch<GEN_NCH; ch++)
+	{
+		dds_stop(ch);
+		mod_stop(ch);
+		core1_arb[ch] = false;
+	}
+	gen_width(width);
+	core1_genwave(OUTA, &core1_def[OUTA]);
+	for (ch=OUTA+1; (ch<GEN_NCH) && (gen_getwidth() == GEN_WIDTH8); ch++)
+		core1_genwave(ch, &core1_def[ch]);
+}
+
+/*
+ * Synthesize the channel definition as carrier into the modulation buffer, and start modulating it
+ * The carrier may hold several periods, the fewer the higher the modulation update rate.
+ * For FM and PM the buffer is limited, so the divider stays at least 1+MOD_MAXREL and can be lowered for the
+ * positive deviation; the planner would otherwise take divider 1 above fsys/GEN_MAXBUFLEN.
+ */
+bool core1_genmod(int ch, c1mod_t *md)
+{
+	wfg_t wf;
+	ch_t *def = &core1_def[ch];
+	double fc = 1.0/def->time;
+	uint32_t maxlen = gen_maxlen();
+
+	if (gen_getwidth() != GEN_WIDTH8) return false;							// Byte samples only
+	maxlen = maxlen/2;														// Carrier fits besides it, see mod_buf()
+	if ((md->mode != MOD_AM) && (_fsys / (fc * (1.0 + MOD_MAXREL)) < maxlen))
+		maxlen = (uint32_t)(_fsys / (fc * (1.0 + MOD_MAXREL)));				// Samples at divider 1+MOD_MAXREL
+	wf.buf = mod_buf(ch);
+	if (wf.buf == NULL) return false;
+	plan_fit(fc, PLAN_NMIN, maxlen, PLAN_MAXPER, PLAN_TOL, &core1_plan[ch]);
+	synth_plan(def, &wf, &core1_plan[ch]);
+	return mod_start(ch, &wf, fc, md->mode, md->fm, md->depth);
+}
+
+/*
+ * Wait in RAM with interrupts disabled until core 0 clears core1_hold, see core1_lockout()
+ * Nothing in here may touch flash, the DMA and PIO keep the outputs playing from SRAM.
+ */
+static void __not_in_flash_func(core1_park)(void)
+{
+	uint32_t irq;
+
+	irq = save_and_disable_interrupts();
+	core1_parked = true;
+	while (core1_hold)
+		tight_loop_contents();
+	core1_parked = false;
+	restore_interrupts(irq);
+}
+
+/*
+ * Core 1 main loop
+ * Wait for a doorbell, then execute all queued commands.
+ * The SDK lockout is not used to park core 1 for flash writes: its FIFO interrupt would swallow the doorbells.
+ */
+void core1_main(void)
+{
+	c1cmd_t *cmd;
+	wfg_t wf;
+	uint32_t len;
+
+	stats_init();															// Cycle counter of core 1
+	while (1)
+	{
+		if (dds_active() || mod_active())
+		{
+			dds_evaluate();													// Keep DDS blocks filled
+			mod_evaluate();													// Update modulated buffers
+			if (!multicore_fifo_rvalid()) continue;							// No doorbell: go on
+		}
+		multicore_fifo_pop_blocking();										// Wait for doorbell
+		while (core1_tail != core1_head)
+		{
+			cmd = &core1_cmd[core1_tail%CORE1_NCMD];
+			if ((cmd->cmd != CORE1_FREQ) && (cmd->cmd != CORE1_TRIG) && (cmd->cmd != CORE1_EN) && (cmd->cmd != CORE1_CLOCK) &&
+				(cmd->cmd != CORE1_PARK))
+			{
+				dds_stop(cmd->ch);											// Channel is taken over
+				mod_stop(cmd->ch);
+				len = ((cmd->cmd == CORE1_WAVE) || (cmd->cmd == CORE1_DAC)) ? cmd->wave.len : 0;
+				gen_alloc(cmd->ch, len);									// Own pair back, or wide for the samples
+				if (cmd->cmd != CORE1_TAKE)									// Output unchanged until the load
+					core1_arb[(uint)cmd->ch%GEN_NCH] = (cmd->cmd == CORE1_WAVE) || (cmd->cmd == CORE1_DAC);
+			}
+			switch (cmd->cmd)
+			{
+			case CORE1_DEF:
+				core1_genwave(cmd->ch, &cmd->def);
+				break;
+			case CORE1_WAVE:
+				gen_play(cmd->ch, &cmd->wave);
+				break;
+			case CORE1_DAC:
+				gen_playdac(cmd->ch, &cmd->wave);
+				break;
+			case CORE1_TAKE:												// Stopped above
+				break;
+			case CORE1_STREAM:
+				gen_stream(cmd->ch, (float)cmd->val);
+				break;
+			case CORE1_DDS:
+				dds_start(cmd->ch, cmd->val, cmd->def.mode);
+				break;
+			case CORE1_FREQ:
+				dds_setfreq(cmd->ch, cmd->val);
+				break;
+			case CORE1_SYNC:
+				core1_gensync((float)cmd->val);
+				break;
+			case CORE1_WIDTH:
+				core1_genwidth((int)cmd->val);
+				break;
+			case CORE1_BURST:
+				if (core1_synth(cmd->ch, &core1_def[cmd->ch], 1, &wf))		// Defined waveform to burst, one period per buffer
+					gen_play(cmd->ch, &wf);
+				gen_burst(cmd->ch, (uint32_t)cmd->val, (uint8_t)cmd->arg);
+				break;
+			case CORE1_TRIG:
+				gen_trigger(cmd->ch);
+				break;
+			case CORE1_EN:
+				gen_enable(cmd->ch, (cmd->val != 0.0));
+				break;
+			case CORE1_CLOCK:
+				if (gen_clock((uint32_t)cmd->val))
+					dds_retune();
+				break;
+			case CORE1_ARM:
+				gen_arm(cmd->ch);
+				break;
+			case CORE1_SEQ:
+				core1_ok = core1_genseq(cmd->ch, cmd->seq, cmd->arg, (cmd->val != 0.0));
+				break;
+			case CORE1_SWEEP:
+				core1_ok = core1_gensweep(cmd->ch, &cmd->sweep);
+				break;
+			case CORE1_MOD:
+				core1_ok = core1_genmod(cmd->ch, &cmd->mod);
+				break;
+			case CORE1_PARK:
+				core1_park();
+				break;
+			}
+			__dmb();														// Command done before releasing slot
+			core1_tail++;
+		}
+	}
+}
+
+
+/*** Core 0 side of the interface ***/
+
+/*
+ * Post a command, copies it into the queue
+ */
+void core1_post(c1cmd_t *cmd)
+{
+	while ((core1_head - core1_tail) >= CORE1_NCMD)							// Queue full: wait for core 1
+		tight_loop_contents();
+	core1_cmd[core1_head%CORE1_NCMD] = *cmd;
+	__dmb();																// Command stored before releasing it
+	core1_head++;
+	multicore_fifo_push_blocking(core1_head);								// Ring the doorbell
+}
+
+/*
+ * Wait until core 1 has executed all posted commands
+ */
+void core1_sync(void)
+{
+	while (core1_tail != core1_head)
+		tight_loop_contents();
+}
+
+/*
+ * Park core 1 in RAM, returns when it waits there with its interrupts disabled
+ * Commands posted before are executed first, nothing may be posted until core1_release().
+ */
+void core1_lockout(void)
+{
+	c1cmd_t cmd;
+
+	cmd.cmd = CORE1_PARK;
+	cmd.ch = 0;
+	core1_hold = true;
+	core1_post(&cmd);
+	while (!core1_parked)
+		tight_loop_contents();
+}
+
+/*
+ * Let core 1 go on after core1_lockout(), returns when it has left RAM
+ */
+void core1_release(void)
+{
+	core1_hold = false;
+	while (core1_parked)
+		tight_loop_contents();
+}
+
+/*
+ * Launch core 1, the generator must have been initialized before
+ */
+void core1_init(void)
+{
+	int ch;
+
+	for (ch=2; ch<GEN_NCH; ch++)											// As A or B, see gen_init()
+		core1_def[ch] = core1_def[ch&1];
+	core1_head = 0;
+	core1_tail = 0;
+	multicore_launch_core1(core1_main);
+}
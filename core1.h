@@ -0,0 +1,104 @@
+#ifndef __CORE1_H__
+#define __CORE1_H__
+/* 
+ * core1.h
+ *
+ * Created: Jan 2022
+ * Author: Arjan te Marvelde
+ *
+ * See core1.c for more information 
+ */
+
+#include "gen.h"
+#include "hmi.h"
+#include "plan.h"
+
+/* Command codes */
+#define CORE1_DEF		0													// Synthesize def and play on ch
+#define CORE1_WAVE		1													// Play wave samples on ch
+#define CORE1_STREAM	2													// Stream on ch, with val sample rate
+#define CORE1_DDS		3													// DDS on ch, def.mode shape and val frequency
+#define CORE1_FREQ		4													// DDS frequency change to val
+#define CORE1_SYNC		5													// Restart all channels in sync, B lagging val degrees
+#define CORE1_WIDTH		6													// Output width to val, GEN_WIDTH8 or GEN_WIDTH16
+#define CORE1_BURST		7													// Arm burst of val periods on ch, idle level arg
+#define CORE1_TRIG		8													// Software trigger of burst on ch
+#define CORE1_EN		9													// Start (val!=0) or stop output ch
+#define CORE1_CLOCK		10													// System clock to val [kHz]
+#define CORE1_ARM		11													// Stop and rewind ch, see gen_arm()
+#define CORE1_SEQ		12													// Sequence of arg segments at seq on ch, loop when val!=0
+#define CORE1_SWEEP		13													// Frequency sweep on ch, as in sweep
+#define CORE1_MOD		14													// Modulation of the ch definition, as in mod
+#define CORE1_DAC		15													// Play wave samples on ch, that are DAC codes already
+#define CORE1_TAKE		16													// Stop DDS and modulation on ch, before core 0 writes gen_loadbuf()
+#define CORE1_PARK		17													// Wait in RAM until released, see core1_lockout()
+
+/*
+ * Sequence segment definition, n periods of def
+ */
+typedef struct
+{
+	ch_t	 def;															// Segment waveform
+	uint32_t n;																// Nr of periods
+} c1seg_t;
+
+/*
+ * Frequency sweep definition, n points from f0 to f1 with dwell time each
+ */
+typedef struct
+{
+	double	 f0, f1;														// Start and stop frequency [Hz]
+	uint32_t n;																// Nr of points, at least 2
+	float	 dwell;															// Time per point [s]
+	bool	 log;															// Logarithmic steps
+} c1sweep_t;
+
+/*
+ * Modulation definition, see mod.h for the modes and the meaning of depth
+ */
+typedef struct
+{
+	int		 mode;															// MOD_AM, MOD_FM or MOD_PM
+	double	 fm;															// Modulating frequency [Hz]
+	float	 depth;															// Modulation depth
+} c1mod_t;
+
+/*
+ * Command structure, posted by core 0 and executed by core 1
+ * A wave buffer or sequence must remain valid until the command has been executed, see core1_sync()
+ * Core 0 may only write samples in place into gen_loadbuf() after CORE1_TAKE and core1_sync(), since DDS and
+ * modulation keep on writing the channel buffers from core 1.
+ */
+typedef struct
+{
+	int		cmd;															// Command code
+	int		ch;																// Output channel
+	ch_t	def;															// Channel definition
+	wfg_t	wave;															// Waveform samples
+	double	val;															// Generic parameter
+	int		arg;															// Generic integer parameter
+	c1seg_t	*seq;															// Sequence segments
+	c1sweep_t sweep;														// Sweep definition
+	c1mod_t	mod;															// Modulation definition
+} c1cmd_t;
+
+/* Last channel definitions and frequency plans, only read on core 0 after core1_sync() */
+extern ch_t core1_def[GEN_NCH];
+extern plan_t core1_plan[GEN_NCH];
+extern bool core1_arb[GEN_NCH];												// Channel plays loaded samples
+extern bool core1_ok;														// Last sequence, sweep or modulation was accepted
+
+/* Launch the generator service on core 1 */
+void core1_init(void);
+
+/* Post a command, waits when the queue is full */
+void core1_post(c1cmd_t *cmd);
+
+/* Wait until all posted commands have been executed */
+void core1_sync(void);
+
+/* Park core 1 in RAM with its interrupts disabled, so core 0 can write flash, and release it again */
+void core1_lockout(void);
+void core1_release(void);
+
+#endif
@@ -0,0 +1,113 @@
+/*
+ * dds.c
+ *
+ * Created: Jan 2022
+ * Author: Arjan te Marvelde
+ * 
+ * Direct Digital Synthesis mode.
+ *
+ * For DDS the channel is switched to streaming mode, with the PIO clock divider set to the integer value DDS_DIV.
+ * So the sample rate is fs = fsys/DDS_DIV, without the jitter of a fractional divider.
+ * Core 1 fills the stream blocks by stepping a 32 bit phase accumulator through a 256 entry waveform table,
+ * the top byte of the accumulator being the table index. 
+ * The output frequency is f = inc * fs / 2^32, giving a resolution of about 1 mHz at fsys=125MHz.
+ * The phase accumulator runs on from block to block, so frequency changes are phase continuous.
+ * The tables contain byte samples, so DDS is only available in 8 bit output mode.
+ */
+
+#include <stdio.h>
+#include "pico/stdlib.h"
+
+#include "uWFG.h"
+#include "gen.h"
+#include "hmi.h"
+#include "synth.h"
+#include "dds.h"
+
+typedef struct
+{
+	bool			 active;												// DDS running on channel
+	uint32_t		 phase;													// Phase accumulator
+	uint32_t		 inc;													// Phase increment per sample
+	double			 freq;													// Output frequency
+	const uint8_t	*table;													// Waveform table, 256 samples
+} dds_t;
+dds_t dds_ch[GEN_NCH];
+
+
+/*
+ * Calculate phase increment for frequency freq
+ */
+static uint32_t dds_inc(double freq)
+{
+	double inc;
+	
+	inc = freq * 4294967296.0 * DDS_DIV / _fsys;							// inc = f * 2^32 / fs
+	if (inc < 0.0) inc = 0.0;
+	if (inc > 2147483648.0) inc = 2147483648.0;								// Nyquist
+	return (uint32_t)(inc + 0.5);
+}
+
+void dds_start(int ch, double freq, int mode)
+{
+	ch = (uint)ch%GEN_NCH;
+	if (gen_getwidth() != GEN_WIDTH8) return;								// Byte samples only
+	dds_ch[ch].phase = 0;
+	dds_ch[ch].freq = freq;
+	dds_ch[ch].inc = dds_inc(freq);
+	dds_ch[ch].table = (mode == HMI_SAW) ? saw256 : sine256;
+	if (!gen_stream(ch, _fsys/DDS_DIV)) return;								// Fixed integer divider
+	dds_ch[ch].active = true;
+	dds_evaluate();															// Fill ring and start DMA
+}
+
+void dds_setfreq(int ch, double freq)
+{
+	dds_ch[(uint)ch%GEN_NCH].freq = freq;
+	dds_ch[(uint)ch%GEN_NCH].inc = dds_inc(freq);
+}
+
+/*
+ * After a system clock change: restore the integer divider and recompute the increment for the new fs
+ */
+void dds_retune(void)
+{
+	int ch;
+	
+	for (ch=0; ch<GEN_NCH; ch++)
+	{
+		if (!dds_ch[ch].active) continue;
+		gen_strrate(ch, _fsys/DDS_DIV);
+		dds_ch[ch].inc = dds_inc(dds_ch[ch].freq);
+	}
+}
+
+void dds_stop(int ch)
+{
+	dds_ch[(uint)ch%GEN_NCH].active = false;
+}
+
+bool dds_active(void)
+{
+	int ch;
+
+	for (ch=0; ch<GEN_NCH; ch++)
+		if (dds_ch[ch].active) return true;
+	return false;
+}
+
+void dds_evaluate(void)
+{
+	int ch;
+	uint8_t *blk;
+	
+	for (ch=0; ch<GEN_NCH; ch++)
+	{
+		if (!dds_ch[ch].active) continue;
+		while ((blk = gen_strblock(ch)) != NULL)							// Fill all free blocks
+		{
+			synth_dds(blk, GEN_STRBLKLEN, dds_ch[ch].table, &dds_ch[ch].phase, dds_ch[ch].inc);
+			gen_strcommit(ch);
+		}
+	}
+}
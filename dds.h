@@ -0,0 +1,32 @@
+#ifndef __DDS_H__
+#define __DDS_H__
+/* 
+ * dds.h
+ *
+ * Created: Jan 2022
+ * Author: Arjan te Marvelde
+ *
+ * See dds.c for more information 
+ */
+
+#define DDS_DIV			32													// Fixed integer PIO clock divider
+
+/* Start DDS on channel ch, with frequency freq [Hz] and waveform mode (HMI_SIN or HMI_SAW) */
+void dds_start(int ch, double freq, int mode);
+
+/* Change frequency, phase continuous */
+void dds_setfreq(int ch, double freq);
+
+/* Adapt to a new system clock, keeping the frequencies */
+void dds_retune(void);
+
+/* Stop DDS on channel ch, output is taken over by a next command */
+void dds_stop(int ch);
+
+/* True when DDS is running on any channel */
+bool dds_active(void);
+
+/* Fill free blocks of the DDS channels, to be called from the core 1 loop */
+void dds_evaluate(void);
+
+#endif
@@ -16,11 +16,60 @@
  *
  * For the waveform generator, a simple PIO program is defined that moves a word from the SM TX fifo into the SM output 
  * shift register (OSR), and then clocks out one byte on the designated pins on every SM clock tick. 
- * A separate SM is allocated for each output channel, thus providing two independent outputs.
+ * A separate SM is allocated for each output channel, thus providing GEN_NCH independent outputs.
+ * Statemachines and DMA channels are claimed at initialization, the SMs from pio0 first and then from pio1.
+ * The programs are loaded in each PIO that has a channel. All state of an output channel is in a gen_ch_t.
  * 
  * Two DMA channels are used for each output, chained in a loop to keep the flow going.
  * The dma_data channel transfers from *buffer to the PIO TX FIFO (paced by the PIO DREQ signal), chained to dma_ctrl channel.
  * The dma_ctrl channel transfers the buffer address back into the dma_data channel read_addr, and chains back to dma_data.
+ *
+ * Each channel has two sample buffers, used in ping-pong fashion. New samples are written in the inactive buffer while
+ * the active one keeps playing. The swap is done by changing the address reloaded by dma_ctrl (g->wfg.buf) and
+ * the dma_data transfer count reload value, so the new waveform starts exactly at the next period boundary.
+ *
+ * When a buffer length is a power of two and the buffer is aligned to it, the dma_data read ring is used to wrap 
+ * around the buffer, and one pass spans many periods, about GEN_RINGUS or as set by gen_passtime(). The dma_ctrl 
+ * reload, with its bus traffic and gap, then occurs once per pass instead of once per period, so such a buffer can be
+ * as short as GEN_MINRINGLEN.
+ * The ring size is part of the dma_data CTRL word, which cannot be changed at a pass boundary, so a change from or 
+ * to ring mode restarts the loop. Swapping between buffers of the same ring size is glitch-free.
+ *
+ * Alternatively the generator can be switched to a single channel of 16 bit samples, on 16 consecutive pins.
+ * Then the channel A SM runs the wfgout16 program, that outputs a halfword per SM clock tick, and the others are disabled.
+ * The DMA is unchanged: the bandwidth in bytes is the same, but each word carries two samples instead of four.
+ *
+ * In burst mode a channel plays its waveform exactly N times after a trigger, and then holds an idle level.
+ * The SM runs the wfgtrig program, which waits for a rising edge on the trigger pin before it starts outputting.
+ * The DMA is armed beforehand, so the TX FIFO is filled and output starts within a few SM clocks after the edge.
+ * A software trigger forces the SM to jump past the wait instructions.
+ * Instead of reloading the data channel read address, the dma_ctrl channel walks a table of control blocks and 
+ * writes {transfer count, read address} into the data channel alias 3 registers, the latter triggering the transfer.
+ * The table contains N blocks for the waveform, one block for a single word of idle samples and a terminating
+ * block with a NULL address. Writing NULL to a trigger register does not start the channel, so the chain ends.
+ * So the burst length does not depend on interrupt latency, nor on any CPU activity.
+ *
+ * In sequence mode a channel plays a list of segments, each a number of periods of its own waveform.
+ * This uses the same control block pattern, but the dma_ctrl channel writes 4 words into the data channel alias 1
+ * registers {ctrl, read address, write address, transfer count}, so each block carries its own CTRL word.
+ * A segment with a power of two buffer is one block using the read ring, otherwise it has a block per period.
+ * When the PIO divider changes between segments, an unpaced block first copies the new value into the SM clkdiv 
+ * register, from the data channel itself. Like with gen_play(), the new divider is effective while the last 
+ * words of the previous segment are still in the TX FIFO.
+ * The last block either chains to a third (reset) channel, that writes the table address into the dma_ctrl read
+ * address trigger to loop, or is followed by a NULL trigger block to end the sequence.
+ *
+ * A frequency sweep does not touch the waveform DMA at all: a separate DMA channel copies a table of clkdiv words 
+ * into the SM clkdiv register, one word per dwell time, so the output continues without gaps.
+ * The DMA pacing timers cannot go below fsys/65535, so the pacing DREQ is the wrap of a PWM slice that has its 
+ * pins assigned to the PIO, which reaches dwell times of over 100msec.
+ *
+ * A channel may have a DAC correction table, see gen_setcal(): a code to code map that compensates the R-2R ladder
+ * errors. It is applied when samples are taken over, by gen_play() while copying or in place, and on the sequence
+ * segments, streaming blocks and burst idle level, with the word parallel synth_lut(). So playback is unchanged,
+ * and the samples handed to the generator are always the uncorrected codes, except for gen_playdac().
+ * The buffers then hold corrected codes, and with a table gen_playref() copies instead of swapping pointers.
+ * The correction is only applied in 8 bit mode.
 
    From RP2040 datasheet, DMA Control / Status word layout:
  
@@ -41,11 +90,10 @@
    0x00000002 [1]     : HIGH_PRIORITY (0): HIGH_PRIORITY gives a channel preferential treatment in issue scheduling: in...
    0x00000001 [0]     : EN (0): DMA Channel Enable
    
- * DMA channel CTRL words, assuming DMA CH0..3 and PIO0 fifo TX0 and TX1:
- *  CH0: 0x0020081f (IRQ_QUIET=0x1, TREQ_SEL=0x00, CHAIN_TO=1, INCR_WRITE=0, INCR_READ=1, DATA_SIZE=2, HIGH_PRIORITY=1, EN=1)	
- *  CH1: 0x003f800f (IRQ_QUIET=0x1, TREQ_SEL=0x3f, CHAIN_TO=0, INCR_WRITE=0, INCR_READ=0, DATA_SIZE=2, HIGH_PRIORITY=1, EN=1)
- *  CH2: 0x0020981f (IRQ_QUIET=0x1, TREQ_SEL=0x01, CHAIN_TO=3, INCR_WRITE=0, INCR_READ=1, DATA_SIZE=2, HIGH_PRIORITY=1, EN=1)	
- *  CH3: 0x003f900f (IRQ_QUIET=0x1, TREQ_SEL=0x3f, CHAIN_TO=2, INCR_WRITE=0, INCR_READ=0, DATA_SIZE=2, HIGH_PRIORITY=1, EN=1)
+ * The DMA channel CTRL words are composed once per output channel with channel_config, in gen_dmacfg():
+ *  dma_data: IRQ_QUIET=1, TREQ_SEL=PIO TX DREQ, CHAIN_TO=dma_ctrl, INCR_WRITE=0, INCR_READ=1, DATA_SIZE=2, HIGH_PRIORITY=1
+ *  dma_ctrl: IRQ_QUIET=1, TREQ_SEL=0x3f, CHAIN_TO=dma_data, INCR_WRITE=0, INCR_READ=0, DATA_SIZE=2, HIGH_PRIORITY=1
+ * They are written to the hardware registers directly, the hot paths do not go through the SDK config functions.
  */
 
 #include <stdio.h>
@@ -53,37 +101,484 @@
 #include <math.h>
 #include "pico/stdlib.h"
 #include "pico/sem.h"
+#include "hardware/sync.h"
+#include "hardware/irq.h"
 #include "hardware/gpio.h"
 #include "hardware/pio.h"
 #include "hardware/dma.h"
 #include "hardware/pll.h"
+#include "hardware/pwm.h"
+#include "hardware/vreg.h"
 
 #include "wfgout.pio.h"
 #include "gen.h"
+#include "calc.h"
+#include "synth.h"
+#include "stats.h"
 
 float _fsys;																	// System clock frequency
 
 /*
- * DMA pipe definitions, assume channels 0, 1, 2 and 3 for A-DATA, A-CTRL, B-DATA and B-CTRL
+ * Output channel definitions, the pin map determines which GPIOs are driven by each channel
+ * Channel A in 16 bit mode drives 16 pins from its base pin, i.e. also those of channel B.
  */
-#define DMA_DC(i)		(((i)==0) ? 0x0020081f : 0x0020981f)				// See derivation above
-#define DMA_CC(i)		(((i)==0) ? 0x003f800f : 0x003f900f)
+#define PINA	0															// PIO channel A and B start pin numbers
+#define PINB	8
+static const uint gen_pins[GEN_NCH] = {PINA, PINB};
+static const uint gen_slices[GEN_NCH] = {6, 7};								// PWM slices pacing a sweep, on PIO pins
+
+#define GEN_SWAPMARGIN		   2											// Minimum nr of words left in pass for a safe swap
+#define GEN_SWAPCYC			  64											// Worst case cycles of the swap critical section
 
 /*
- * Global variables that hold the active parameters for both output channels
+ * Output channel state, one for each channel
+ * The resources are claimed once in gen_init(), the DMA CTRL words are composed there as well.
+ * The buffers are assigned by gen_split() and gen_alloc(), and are NULL when the channel is not available in the
+ * current output width, or when its buffers are taken by its partner channel.
+ * The two buffers of a channel are contiguous, which is used for streaming.
+ *
+ * Streaming mode administration
+ * The two samplebuffers of a channel are split in a ring of GEN_STRNBLK blocks.
+ * The dma_ctrl channel walks the block address table, using the read ring to wrap around.
+ * Each completed dma_data transfer raises DMA_IRQ_0, the handler counts the played blocks.
+ * Blocks are counted continuously, the block index is the count modulo GEN_STRNBLK. The handler takes the count
+ * from the block the DMA is reading, not from the nr of interrupts: while interrupts are disabled for longer than a
+ * block, e.g. during a flash write, several blocks complete with one pending interrupt. A whole ring can not be
+ * told apart from none, so interrupts must not be off for GEN_STRNBLK blocks.
+ *
+ * Burst mode administration
+ * The control block table holds {transfer_count, read_addr} pairs, the idle word contains 4 idle samples.
  */
-#define PINA	0															// PIO channe A and B start pin numbers
-#define PINB	8
+typedef struct
+{
+	PIO		 pio;															// PIO block and statemachine
+	uint	 sm;
+	uint	 pin;															// First output pin
+	uint	 prog8, prog16, progtrig;										// Program offsets in this PIO
+	uint	 dma_data, dma_ctrl;											// DMA channels
+	uint32_t dc, cc;														// DMA CTRL words: loop mode
+	uint32_t sdc, scc;														//  streaming mode
+	uint32_t bcc;															//  burst mode control blocks
+	uint32_t qcc, ddc, rcc;													//  sequence control blocks, divider block and reset
+	int		 dma_seq;														// Sequence reset channel, -1 until used
+	int		 dma_sweep;														// Sweep channel, -1 until used
+	uint32_t swn;															// Nr of sweep points
+	int		 mode;															// Active channel mode
+	uint32_t ring;															// Active read ring size in loop mode, log2 or 0
+	uint32_t ringus;														// Pass duration in ring mode, usec
+	wfg_t	 wfg;															// Active waveform, wfg.buf is the dma_ctrl source
+	uint8_t *buf[2];														// Channel buffers, NULL when not available
+	uint32_t buflen;														// Size of each of them in bytes
+	uint8_t *cal;															// DAC correction table, NULL when none
+	uint8_t *strtab[GEN_STRNBLK] __attribute__((aligned(4*GEN_STRNBLK)));	// Aligned for RING_SIZE
+	volatile uint32_t strrd;												// Nr of blocks played by DMA
+	volatile uint32_t strwr;												// Nr of blocks committed by producer
+	volatile uint32_t strunder;												// Nr of blocks played without commit
+	volatile uint32_t reloads;												// Nr of dma_ctrl reloads counted
+	uint32_t btab[2*(GEN_MAXBURST+2)] __attribute__((aligned(8)));			// Burst control blocks
+	uint32_t bidle;															// Burst idle samples
+	uint32_t seqtab[4*GEN_SEQNBLK];											// Sequence control blocks
+	uint32_t seqdiv[GEN_MAXSEG];											// Sequence segment PIO dividers
+	uint32_t seqstart;														// Sequence table address, reset channel source
+	seg_t	 seg[GEN_MAXSEG];												// Sequence segments
+	int		 nseg;
+} gen_ch_t;
+
+gen_ch_t gen_ch[GEN_NCH];
+int		 gen_wid = GEN_WIDTH8;												// Active output width, in bytes per sample
 
-#define GEN_MINBUFLEN		  20											// Minimum nr of samples (10msec - 160nsec)
-#define GEN_MAXBUFLEN		2000											// Maximum buffer size (1sec - 16usec)
-wfg_t	wfg_ctrl[2];														// Active 
+/*
+ * Samplebuffer pool, split over the channels by gen_split() according to the output width
+ * Each active channel gets two buffers, one is playing while the other is filled.
+ * In 8 bit mode each channel has a pair of gen_buflen bytes, in 16 bit mode channel A gets all of the pool.
+ * In 8 bit mode a channel can take the pair of its partner ch^1 with gen_alloc() while the partner is idle or
+ * stopped, for buffers of twice the size: its own pair becomes the first buffer, the partner pair the second.
+ * The partner is then not available, until the channel plays from its own pair again and gen_alloc() returns it.
+ * All pairs are aligned to their size, so power of two waveforms can use the read ring in either layout.
+ * The modulation carrier is kept in the inactive buffer, see mod_buf(), so the sample buffers are this pool, the
+ * waveform cache (cache_buf, 8KB) and the sweep tables (core1_swtab, 8KB), 24KB in all.
+ */
+uint8_t  gen_pool[GEN_POOLLEN] __attribute__((aligned(2*GEN_MAXBUFLEN)));	// DMA requires to align on 32 bit boundary
+uint32_t gen_buflen;														// Size of each buffer of a pair in bytes
+wfg_t	 gen_boot[GEN_NCH];													// Initial waveforms, see gen_preset()
+uint8_t	 gen_lut[GEN_NCH][GEN_CALLEN];										// DAC correction tables
 
-// Allocate maximum size samplebuffers for channel A and B 
-uint8_t a_buf[GEN_MAXBUFLEN] __attribute__((aligned(4)));					// DMA requires to align on 32 bit boundary
-uint8_t b_buf[GEN_MAXBUFLEN] __attribute__((aligned(4)));
+/*
+ * Channel ch state, NULL when ch is not available in the current output width
+ */
+static gen_ch_t *gen_get(int ch)
+{
+	if ((uint)ch >= GEN_NCH) return NULL;
+	if (gen_ch[ch].buf[0] == NULL) return NULL;
+	return &gen_ch[ch];
+}
 
+/*
+ * Take over n samples from src into dst, through the correction table unless dac is set
+ * In place when dst is src, and only a copy in 16 bit mode or without table.
+ */
+static void gen_take(gen_ch_t *g, uint8_t *dst, const uint8_t *src, uint32_t n, bool dac)
+{
+	if ((g->cal != NULL) && !dac && (gen_wid == GEN_WIDTH8))
+		synth_lut(dst, src, n, g->cal);
+	else if (dst != src)
+		memcpy(dst, src, n);
+}
 
+/*
+ * Decode the system clock frequency from the PLL registers
+ */
+float gen_getfsys(void)
+{
+	return calc_fsys(pll_sys_hw->fbdiv_int, (pll_sys_hw->prim&0x00070000)>>16, (pll_sys_hw->prim&0x00007000)>>12);
+}
+
+/*
+ * Read ring size for a buffer, as log2 of its length, or 0 when it is not a power of two aligned to its length
+ */
+static uint32_t gen_ringsize(uint8_t *buf, uint32_t len)
+{
+	if ((len < GEN_MINRINGLEN) || (len & (len-1))) return 0;
+	if ((uint32_t)buf & (len-1)) return 0;
+	return (uint32_t)__builtin_ctz(len);
+}
+
+/*
+ * Nr of words in a dma_data pass for a buffer of len bytes, played with PIO clock divider register value clkdiv
+ * Without ring this is one period, with ring the nr of whole periods that take about us, at least one.
+ */
+static uint32_t gen_pass(uint32_t len, uint32_t ring, uint32_t clkdiv, uint32_t us)
+{
+	float wps;																// Words per second
+	uint32_t m;
+
+	if (ring == 0) return len/4;
+	wps = _fsys * 65536.0f / (float)clkdiv * gen_wid / 4;					// clkdiv is in 1/65536
+	m = (uint32_t)(wps * us * 1.0e-6f / (len/4));							// Periods per pass
+	if (m < 1) m = 1;
+	return m * (len/4);
+}
+
+/*
+ * Stop the DMA of a channel, and the block counting interrupt
+ * A sweep is stopped as well, since it would overwrite the divider.
+ */
+static void gen_unsweep(gen_ch_t *g)
+{
+	if (g->dma_sweep < 0) return;
+	dma_channel_abort((uint)g->dma_sweep);
+	pwm_set_enabled(gen_slices[g - gen_ch], false);
+}
+static void gen_stop(gen_ch_t *g)
+{
+	dma_hw->inte0 &= ~(1u<<g->dma_data);									// Stop block counting
+	gen_unsweep(g);															// Stop clkdiv writes
+	if (g->dma_seq >= 0) dma_channel_abort((uint)g->dma_seq);				// Stop sequence loop
+	dma_channel_abort(g->dma_ctrl);											// Stop DMA transfers, control first
+	dma_channel_abort(g->dma_data);
+}
+
+/*
+ * (Re)start the DMA loop on a channel, playing the waveform in g->wfg
+ */
+static void gen_loop(gen_ch_t *g)
+{
+	gen_stop(g);															// No interrupts in loop mode
+	g->ring = gen_ringsize(g->wfg.buf, g->wfg.len);
+	dma_hw->ch[g->dma_data].read_addr = (io_rw_32)g->wfg.buf;				// Read from waveform buffer
+	dma_hw->ch[g->dma_data].write_addr = (io_rw_32)&g->pio->txf[g->sm];		// Write to PIO TX fifo
+	dma_hw->ch[g->dma_data].transfer_count = gen_pass(g->wfg.len, g->ring, g->pio->sm[g->sm].clkdiv, g->ringus);
+	dma_hw->ch[g->dma_data].al1_ctrl = g->dc | (g->ring<<DMA_CH0_CTRL_TRIG_RING_SIZE_LSB);	// Ctrl word without starting the DMA
+	dma_hw->ch[g->dma_ctrl].read_addr = (io_rw_32)&(g->wfg.buf);			// Read from waveform buffer address reference
+	dma_hw->ch[g->dma_ctrl].write_addr = (io_rw_32)&dma_hw->ch[g->dma_data].read_addr;	// Write to data channel read address
+	dma_hw->ch[g->dma_ctrl].transfer_count = 1;								// One word to transfer
+	dma_hw->ch[g->dma_ctrl].ctrl_trig = g->cc;								// Write ctrl word and start DMA
+	g->mode = GEN_LOOP;
+}
+
+/*
+ * Give channel ch its own pair of buffers, in 8 bit mode
+ */
+static void gen_ownpair(int ch)
+{
+	gen_ch[ch].buf[0] = &gen_pool[(2*ch)*gen_buflen];
+	gen_ch[ch].buf[1] = &gen_pool[(2*ch+1)*gen_buflen];
+	gen_ch[ch].buflen = gen_buflen;
+}
+
+/*
+ * Divide the samplebuffer pool over the channels, for the current output width
+ * Each channel gets its own pair, the channels must be stopped.
+ */
+static void gen_split(void)
+{
+	int ch;
+
+	if (gen_wid == GEN_WIDTH16)
+	{
+		gen_buflen = GEN_POOLLEN/2;
+		for (ch=0; ch<GEN_NCH; ch++)
+		{
+			gen_ch[ch].buf[0] = (ch == OUTA) ? &gen_pool[0] : NULL;
+			gen_ch[ch].buf[1] = (ch == OUTA) ? &gen_pool[gen_buflen] : NULL;
+			gen_ch[ch].buflen = (ch == OUTA) ? gen_buflen : 0;
+		}
+	}
+	else
+	{
+		gen_buflen = GEN_POOLLEN/(2*GEN_NCH);
+		for (ch=0; ch<GEN_NCH; ch++)
+			gen_ownpair(ch);
+	}
+}
+
+/*
+ * Maximum buffer length in bytes for the current output width, with the own pair of a channel
+ */
+uint32_t gen_maxlen(void)
+{
+	return gen_buflen;
+}
+
+/*
+ * Maximum buffer length in bytes that gen_alloc() can give, when the partner channel is free
+ */
+uint32_t gen_alloclen(void)
+{
+	return (gen_wid == GEN_WIDTH16) ? gen_buflen : 2*gen_buflen;
+}
+
+/*
+ * (Re)load the free running output program on a channel, the statemachine is enabled
+ */
+static void gen_program(gen_ch_t *g, float div)
+{
+	wfgout_program_init(g->pio, g->sm, g->prog8, g->pin, (uint)8, div);
+}
+
+/*
+ * Revert a channel from burst mode to the free running output program, the generator mode becomes GEN_IDLE
+ * The SM clock divider must be set again.
+ */
+static void gen_unburst(gen_ch_t *g)
+{
+	if (g->mode != GEN_BURST) return;
+	gen_stop(g);															// Stop control blocks first
+	gen_program(g, 1.0);
+	g->mode = GEN_IDLE;
+}
+
+/*
+ * Return the partner pair that wide channel ch has taken, when it no longer plays from there
+ * Not in loop mode only its own pair is in use; in loop mode the active waveform must fit one buffer of the own
+ * pair, and the DMA must have left the partner pair, which takes at most one pass after a swap.
+ * Returns false when the partner pair is still in use.
+ */
+static bool gen_giveback(int ch)
+{
+	gen_ch_t *g = &gen_ch[ch];
+	uint8_t *own = &gen_pool[(2*ch)*gen_buflen], *other = &gen_pool[(2*(ch^1))*gen_buflen];
+	uint32_t off;
+
+	if (g->buflen <= gen_buflen) return true;								// Not wide
+	if ((g->mode == GEN_LOOP) || (g->mode == GEN_BURST))
+	{
+		if (((uint32_t)g->wfg.buf - (uint32_t)other) < 2*gen_buflen) return false;	// Playing the partner pair
+		off = (uint32_t)g->wfg.buf - (uint32_t)own;
+		if ((off < 2*gen_buflen) && ((off%gen_buflen) + g->wfg.len > gen_buflen)) return false;	// Spans both own buffers
+		while ((dma_hw->ch[g->dma_data].read_addr - (uint32_t)other) < 2*gen_buflen)	// Last pass of the partner pair
+			tight_loop_contents();
+	}
+	gen_ownpair(ch);
+	gen_ownpair(ch^1);
+	return true;
+}
+
+/*
+ * Make the buffers of channel ch hold len bytes, returns false when that is not possible now
+ * In 8 bit mode a len up to twice gen_maxlen() is given by taking the pair of partner channel ch^1, which must be
+ * idle or have its statemachine stopped; the partner output then holds its last sample until the pair is returned.
+ * With a len that fits its own pair, a wide channel returns the partner pair when it can, see gen_giveback(), and
+ * a channel of which the pair was taken gets it back when its partner can give it.
+ * Call on core 1, or on core 0 after core1_sync(), before gen_loadbuf().
+ */
+bool gen_alloc(int ch, uint32_t len)
+{
+	gen_ch_t *g, *p;
+
+	if ((uint)ch >= GEN_NCH) return false;
+	g = &gen_ch[ch];
+	if (gen_wid == GEN_WIDTH16) return ((g->buf[0] != NULL) && (len <= g->buflen));
+	p = &gen_ch[ch^1];
+	if ((g->buf[0] == NULL) && !gen_giveback(ch^1)) return false;			// Pair is taken by the partner
+	if (len <= gen_buflen)
+	{
+		gen_giveback(ch);													// Best effort, may still be in use
+		return true;
+	}
+	if (len > 2*gen_buflen) return false;
+	if (g->buflen > gen_buflen) return true;								// Wide already
+	if ((p->mode != GEN_IDLE) && (p->pio->ctrl & (1u << p->sm))) return false;	// Partner is running
+	gen_unburst(p);
+	gen_stop(p);
+	p->mode = GEN_IDLE;
+	p->buf[0] = NULL;
+	p->buf[1] = NULL;
+	p->buflen = 0;
+	g->buf[0] = &gen_pool[(2*ch)*gen_buflen];								// Own pair, holds the active buffer
+	g->buf[1] = &gen_pool[(2*(ch^1))*gen_buflen];							// Partner pair
+	g->buflen = 2*gen_buflen;
+	return true;
+}
+
+/*
+ * DMA_IRQ_0 handler, counts the blocks played by streaming channels
+ * When a block completes, the DMA already started the next one, this should have been committed.
+ * While gen_count() is on, the loop mode reloads are counted as well.
+ */
+static void gen_dmairq(void)
+{
+	gen_ch_t *g;
+	uint32_t rd, wr;
+	int ch;
+	
+	for (ch=0; ch<GEN_NCH; ch++)
+	{
+		g = &gen_ch[ch];
+		if (dma_hw->ints0 & (1u<<g->dma_ctrl))
+		{
+			dma_hw->ints0 = 1u<<g->dma_ctrl;								// Acknowledge interrupt
+			if (++g->reloads >= GEN_MAXCOUNT)								// Too fast: stop counting
+				dma_hw->inte0 &= ~(1u<<g->dma_ctrl);
+		}
+		if (!(dma_hw->ints0 & (1u<<g->dma_data))) continue;
+		dma_hw->ints0 = 1u<<g->dma_data;									// Acknowledge interrupt
+		if (g->mode != GEN_STREAM) continue;
+		rd = (dma_hw->ch[g->dma_data].read_addr - (uint32_t)g->buf[0]) / GEN_STRBLKLEN;	// Block being played
+		rd = g->strrd + (rd - g->strrd) % GEN_STRNBLK;						// Blocks played since the last time
+		wr = ((int32_t)(g->strwr - g->strrd) > 0) ? g->strwr : g->strrd + 1;	// First block not committed
+		if ((int32_t)(rd - wr) >= 0)										// Blocks started without commit
+			g->strunder += rd - wr + 1;
+		g->strrd = rd;
+	}
+}
+
+/*
+ * Claim a statemachine for channel ch, from pio0 when possible and pio1 otherwise
+ * The programs are loaded once in each PIO, a later channel on the same PIO reuses the offsets.
+ */
+static void gen_claim(int ch)
+{
+	gen_ch_t *g = &gen_ch[ch];
+	int sm, i;
+
+	g->pio = pio0;
+	sm = pio_claim_unused_sm(pio0, false);
+	if (sm < 0)
+	{
+		g->pio = pio1;
+		sm = pio_claim_unused_sm(pio1, true);								// Panics when none is left
+	}
+	g->sm = (uint)sm;
+	g->pin = gen_pins[ch];
+
+	for (i=0; i<ch; i++)													// Programs already in this PIO?
+		if (gen_ch[i].pio == g->pio) break;
+	if (i<ch)
+	{
+		g->prog8 = gen_ch[i].prog8;
+		g->prog16 = gen_ch[i].prog16;
+		g->progtrig = gen_ch[i].progtrig;
+	}
+	else
+	{
+		g->prog8 = pio_add_program(g->pio, &wfgout_program);				// Move programs to PIO space and obtain their offset
+		g->prog16 = pio_add_program(g->pio, &wfgout16_program);
+		g->progtrig = pio_add_program(g->pio, &wfgtrig_program);
+	}
+
+	g->dma_data = (uint)dma_claim_unused_channel(true);
+	g->dma_ctrl = (uint)dma_claim_unused_channel(true);
+	g->dma_seq = -1;														// Claimed by gen_seq()
+	g->dma_sweep = -1;														// Claimed by gen_sweep()
+}
+
+/*
+ * Compose the DMA CTRL words of a channel, see the derivation above
+ * The data channel is paced by the SM TX DREQ, the control channel runs unpaced.
+ */
+static void gen_dmacfg(gen_ch_t *g)
+{
+	dma_channel_config c;
+
+	c = dma_channel_get_default_config(g->dma_data);						// Data: read increment, 32 bit
+	channel_config_set_dreq(&c, pio_get_dreq(g->pio, g->sm, true));
+	channel_config_set_chain_to(&c, g->dma_ctrl);
+	channel_config_set_high_priority(&c, true);
+	channel_config_set_irq_quiet(&c, false);
+	g->sdc = channel_config_get_ctrl_value(&c);								// Streaming: IRQ on each block
+	channel_config_set_irq_quiet(&c, true);
+	g->dc = channel_config_get_ctrl_value(&c);
+
+	c = dma_channel_get_default_config(g->dma_ctrl);						// Control: one word, no increments
+	channel_config_set_read_increment(&c, false);
+	channel_config_set_chain_to(&c, g->dma_data);
+	channel_config_set_high_priority(&c, true);
+	channel_config_set_irq_quiet(&c, true);
+	g->cc = channel_config_get_ctrl_value(&c);
+	channel_config_set_read_increment(&c, true);							// Streaming: walk block address table
+	channel_config_set_ring(&c, false, 4);									//  of 4 words
+	g->scc = channel_config_get_ctrl_value(&c);
+
+	c = dma_channel_get_default_config(g->dma_ctrl);						// Burst: CHAIN_TO=self
+	channel_config_set_write_increment(&c, true);							//  read and write increment
+	channel_config_set_ring(&c, true, 3);									//  write ring over 2 registers
+	channel_config_set_high_priority(&c, true);
+	channel_config_set_irq_quiet(&c, true);
+	g->bcc = channel_config_get_ctrl_value(&c);
+
+	c = dma_channel_get_default_config(g->dma_ctrl);						// Sequence: CHAIN_TO=self
+	channel_config_set_write_increment(&c, true);							//  read and write increment
+	channel_config_set_ring(&c, true, 4);									//  write ring over 4 registers
+	channel_config_set_high_priority(&c, true);
+	channel_config_set_irq_quiet(&c, true);
+	g->qcc = channel_config_get_ctrl_value(&c);
+
+	c = dma_channel_get_default_config(g->dma_data);						// Sequence divider: one word, unpaced
+	channel_config_set_read_increment(&c, false);
+	channel_config_set_chain_to(&c, g->dma_ctrl);
+	channel_config_set_high_priority(&c, true);
+	channel_config_set_irq_quiet(&c, true);
+	g->ddc = channel_config_get_ctrl_value(&c);
+}
+
+/*
+ * Set the initial waveform of channel ch, instead of the default square or triangle
+ * The 8 bit samples are copied by gen_init(), so they may be read from XIP flash, see preset_init().
+ */
+void gen_preset(int ch, wfg_t *wave)
+{
+	gen_boot[(uint)ch%GEN_NCH] = *wave;
+}
+
+/*
+ * Set the DAC correction table of channel ch, GEN_CALLEN entries that give the code to output for each sample value
+ * NULL removes the table. It takes effect from the next waveform, so the one playing is not changed.
+ * Call on core 1, or on core 0 after core1_sync(); also before gen_init(), see preset_init().
+ */
+void gen_setcal(int ch, const uint8_t *lut)
+{
+	gen_ch_t *g = &gen_ch[(uint)ch%GEN_NCH];
+
+	if (lut == NULL) { g->cal = NULL; return; }
+	memcpy(gen_lut[(uint)ch%GEN_NCH], lut, GEN_CALLEN);
+	g->cal = gen_lut[(uint)ch%GEN_NCH];
+}
+
+const uint8_t *gen_getcal(int ch)
+{
+	return gen_ch[(uint)ch%GEN_NCH].cal;
+}
 
 /*
  * Unit initialization, !only call this once!
@@ -91,100 +586,996 @@ uint8_t b_buf[GEN_MAXBUFLEN] __attribute__((aligned(4)));
  */
 void gen_init()
 {
+	gen_ch_t *g;
 	float div;
-	uint i, offset;
+	uint i;
 	int ch;
 	
 	/* Retrieve system clock frequency */
-	_fsys = 1.2e7;															// Assume 12MHz XOSC
-	_fsys *= pll_sys_hw->fbdiv_int&0xfff;									// Feedback divider
-	_fsys /= (pll_sys_hw->prim&0x00070000)>>16;								// Primary divider 1
-	_fsys /= (pll_sys_hw->prim&0x00007000)>>12;								// Primary divider 2
+	_fsys = gen_getfsys();
+
+	/* Claim statemachines and DMA channels */
+	for (ch=0; ch<GEN_NCH; ch++)
+	{
+		gen_claim(ch);
+		gen_dmacfg(&gen_ch[ch]);
+		gen_ch[ch].ringus = GEN_RINGUS;
+	}
 
 	/* Set GPIO pin behaviour */
-	for (i=0; i<8; i++)														// Initialize the channel A and B  pins
+	for (ch=0; ch<GEN_NCH; ch++)
 	{
-		gpio_set_function(PINA+i, GPIO_FUNC_PIO0);							// Function: PIO
-		gpio_set_slew_rate(PINA+i, GPIO_SLEW_RATE_FAST);					// No slewrate limiting
-		gpio_set_drive_strength(PINA+i, GPIO_DRIVE_STRENGTH_8MA);			// Drive 8mA (might increase to 12)
-		gpio_set_function(PINB+i, GPIO_FUNC_PIO0);
-		gpio_set_slew_rate(PINB+i, GPIO_SLEW_RATE_FAST);
-		gpio_set_drive_strength(PINB+i, GPIO_DRIVE_STRENGTH_8MA);
+		g = &gen_ch[ch];
+		for (i=0; i<8; i++)													// Initialize the channel pins
+		{
+			pio_gpio_init(g->pio, g->pin+i);								// Function: PIO
+			gpio_set_slew_rate(g->pin+i, GPIO_SLEW_RATE_FAST);				// No slewrate limiting
+			gpio_set_drive_strength(g->pin+i, GPIO_DRIVE_STRENGTH_8MA);		// Drive 8mA (might increase to 12)
+		}
 	}
 	
 	/* Initialize the buffers and channel control structures */
-	for (i= 0; i<64; i++) {a_buf[i] = 0x00; a_buf[i+64] = 0xff;}			// Square wave
-	wfg_ctrl[0].buf = a_buf;												//  in A sample buffer
-	wfg_ctrl[0].len = 128; 													//  of 128 samples
-	wfg_ctrl[0].dur = 1.0e-6;												//  and 1 usec duration
-	for (i= 0; i<64; i++) {b_buf[i] = i*4; b_buf[i+64] = 0xff-(i*4);} 		// Triangle wave
-	wfg_ctrl[1].buf = b_buf;												//  in B sample buffer
-	wfg_ctrl[1].len = 128;													//  of 128 samples
-	wfg_ctrl[1].dur = 1.0e-6;												//  and 1usec duration
+	gen_split();
+	for (ch=0; ch<GEN_NCH; ch++)
+	{
+		g = &gen_ch[ch];
+		g->wfg.buf = g->buf[0];
+		if ((gen_boot[ch].len >= GEN_MINBUFLEN) && (gen_boot[ch].len <= gen_buflen) && !(gen_boot[ch].len&3))
+		{
+			memcpy(g->buf[0], gen_boot[ch].buf, gen_boot[ch].len);			// Preset samples, DAC codes
+			g->wfg.len = gen_boot[ch].len;
+			g->wfg.dur = gen_boot[ch].dur;
+			continue;
+		}
+		if (ch&1)
+			for (i= 0; i<64; i++) {g->buf[0][i] = i*4; g->buf[0][i+64] = 0xff-(i*4);}	// Triangle wave
+		else
+			for (i= 0; i<64; i++) {g->buf[0][i] = 0x00; g->buf[0][i+64] = 0xff;}		// Square wave
+		g->wfg.len = 128; 													//  of 128 samples in sample buffer
+		g->wfg.dur = 1.0e-6;												//  and 1 usec duration
+		gen_take(g, g->buf[0], g->buf[0], 128, false);
+	}
+
+	/* Burst trigger input */
+	gpio_init(wfgtrig_TRIG_PIN);
+	gpio_set_dir(wfgtrig_TRIG_PIN, GPIO_IN);
+	gpio_pull_down(wfgtrig_TRIG_PIN);										// Defined level when open
+
+	/* Streaming DMA interrupt */
+	irq_set_exclusive_handler(DMA_IRQ_0, gen_dmairq);
+	irq_set_enabled(DMA_IRQ_0, true);
+
+	/* Initialize the channel statemachines */
+	for (ch=0; ch<GEN_NCH; ch++)
+	{
+		g = &gen_ch[ch];
+		div = _fsys * g->wfg.dur / g->wfg.len;								// Ratio of fsys and channel sampleclock
+		if (div < 1.0) div=1.0; 											// Cannot get higher than FSYS
+		gen_program(g, div);												// Invoke PIO initializer
+		gen_loop(g);														// Start the DMA loop
+	}
+}
+
+/*
+ * Switch the output width, all channels are stopped until the next gen_play().
+ * GEN_WIDTH16 drives pins PINA..PINA+15 from the channel A SM, the other channels are not available then.
+ */
+void gen_width(int width)
+{
+	gen_ch_t *g;
+	int ch;
+
+	if (width != GEN_WIDTH16) width = GEN_WIDTH8;
+	if (width == gen_wid) return;
+	
+	for (ch=0; ch<GEN_NCH; ch++)
+	{
+		g = &gen_ch[ch];
+		pio_sm_set_enabled(g->pio, g->sm, false);							// Stop statemachine
+		gen_stop(g);
+		pio_sm_clear_fifos(g->pio, g->sm);
+		g->mode = GEN_IDLE;
+	}
+	
+	if (width == GEN_WIDTH16)
+	{
+		g = &gen_ch[OUTA];
+		wfgout16_program_init(g->pio, g->sm, g->prog16, g->pin, (uint)16, 1.0);
+	}
+	else
+		for (ch=0; ch<GEN_NCH; ch++)
+			gen_program(&gen_ch[ch], 1.0);
+	gen_wid = width;
+	gen_split();															// Redistribute buffers
+}
+
+int gen_getwidth(void)
+{
+	return gen_wid;
+}
 
-	/* Initialize PIO and channel A and B statemachines */
-	offset = pio_add_program(pio0, &wfgout_program);						// Move program to PIO space and obtain its offset
+/*
+ * Change the system clock to khz [kHz], returns false when there is no valid PLL setting
+ * The core voltage is raised before going above 133MHz, and lowered after going back.
+ * The clock dividers of all channels are recomputed, so the output frequencies remain the same.
+ * Note that clk_peri follows clk_sys, so the I2C baudrate needs to be set again by the caller.
+ * The flash SPI clock is clk_sys divided by PICO_FLASH_SPI_CLKDIV, 2 by default, and the flash is rated for 133MHz.
+ * Code runs from XIP flash, so above GEN_MAXKHZ it would fail. A larger divider slows down all XIP accesses,
+ * so instead the clock is limited to GEN_MAXKHZ.
+ */
+bool gen_clock(uint32_t khz)
+{
+	uint vco, pd1, pd2;
+	enum vreg_voltage v;
+	gen_ch_t *g;
+	int ch, i;
 
-	for (ch=0; ch<2; ch++)
+	if ((khz < GEN_MINKHZ) || (khz > GEN_MAXKHZ)) return false;
+	if (!check_sys_clock_khz(khz, &vco, &pd1, &pd2)) return false;
+	if (khz > 200000) v = VREG_VOLTAGE_1_20;
+	else if (khz > 133000) v = VREG_VOLTAGE_1_15;
+	else v = VREG_VOLTAGE_DEFAULT;
+	
+	if (1000.0*khz > _fsys)													// Going up: voltage first
 	{
-		div = _fsys * wfg_ctrl[ch].dur / wfg_ctrl[ch].len;						// Ratio of fsys and channel B sampleclock
-		if (div < 1.0) div=1.0; 												// Cannot get higher than FSYS
-		wfgout_program_init(pio0, ch, offset, (uint)(ch*PINB), (uint)8, div);	// Invoke PIO initializer for channel B 
+		vreg_set_voltage(v);
+		busy_wait_us_32(1000);												// Settle
+	}
+	set_sys_clock_pll(vco, pd1, pd2);
+	_fsys = gen_getfsys();
+	if (1000.0*khz <= _fsys)												// Going down, or same
+		vreg_set_voltage(v);
+
+	for (ch=0; ch<GEN_NCH; ch++)											// Recompute sample clocks
+	{
+		g = &gen_ch[ch];
+		if (g->mode == GEN_SEQ)												// Divider blocks read from seqdiv[]
+			for (i=0; i<g->nseg; i++)
+				g->seqdiv[i] = calc_playdiv(_fsys, g->seg[i].wave.dur, g->seg[i].wave.len/gen_wid);
+		if ((g->mode == GEN_IDLE) || (g->wfg.len == 0)) continue;
+		g->pio->sm[g->sm].clkdiv = (io_rw_32)calc_playdiv(_fsys, g->wfg.dur, g->wfg.len/gen_wid);
+	}
+	return true;
+}
+
+/*
+ * Enable or disable the statemachine of channel ch, a stopped output holds its last sample value
+ */
+void gen_enable(int ch, bool on)
+{
+	gen_ch_t *g = gen_get(ch);
+
+	if (g == NULL) return;
+	pio_sm_set_enabled(g->pio, g->sm, on);
+}
+
+/*
+ * Actual PIO clock divider and sample rate of channel ch
+ */
+float gen_getdiv(int ch)
+{
+	gen_ch_t *g = &gen_ch[(uint)ch%GEN_NCH];
+
+	return calc_divval(g->pio->sm[g->sm].clkdiv);
+}
+float gen_getrate(int ch)
+{
+	return _fsys / gen_getdiv(ch);
+}
+
+/*
+ * Return the buffer that the next gen_play() on channel ch will copy into, so samples can be written in place.
+ * In loop mode this is the inactive buffer, after a previous swap has become effective.
+ * Otherwise it is the first buffer, which may still be in use for streaming or a burst until gen_play().
+ * The buffer holds gen_maxlen() bytes, or more after gen_alloc(), NULL is returned for a channel that is not available.
+ */
+static uint8_t *gen_next(gen_ch_t *g)
+{
+	return (((uint32_t)g->wfg.buf - (uint32_t)g->buf[0]) < g->buflen) ? g->buf[1] : g->buf[0];	// Not the active one
+}
+uint8_t *gen_loadbuf(int ch)
+{
+	gen_ch_t *g = gen_get(ch);
+	uint8_t *next;
+
+	if (g == NULL) return NULL;
+	if (g->mode != GEN_LOOP) return g->buf[0];
+	next = gen_next(g);
+	while ((dma_hw->ch[g->dma_data].read_addr - (uint32_t)next) < g->buflen)	// Wait until a previous swap is effective
+		tight_loop_contents();
+	return next;
+}
+
+/*
+ * Returns true when gen_loadbuf() on channel ch would not wait, i.e. the DMA is not reading from the next buffer
+ */
+bool gen_loadfree(int ch)
+{
+	gen_ch_t *g = gen_get(ch);
+	uint8_t *next;
 
-		dma_hw->ch[2*ch].read_addr = (io_rw_32)wfg_ctrl[ch].buf;				// Read from waveform buffer
-		dma_hw->ch[2*ch].write_addr = (io_rw_32)&pio0->txf[ch];					// Write to PIO TX fifo
-		dma_hw->ch[2*ch].transfer_count = wfg_ctrl[ch].len/4;					// Nr of 32 bit words to transfer
-		dma_hw->ch[2*ch].al1_ctrl = DMA_DC(ch);									// Write ctrl word without starting the DMA
-		dma_hw->ch[2*ch+1].read_addr = (io_rw_32)&(wfg_ctrl[ch].buf);			// Read from waveform buffer address reference
-		dma_hw->ch[2*ch+1].write_addr = (io_rw_32)&dma_hw->ch[2*ch].read_addr;	// Write to data channel read address
-		dma_hw->ch[2*ch+1].transfer_count = 1;									// One word to transfer
-		dma_hw->ch[2*ch+1].ctrl_trig = DMA_CC(ch);								// Write ctrl word and start DMA
+	if (g == NULL) return false;
+	if (g->mode != GEN_LOOP) return true;
+	next = gen_next(g);
+	return ((dma_hw->ch[g->dma_data].read_addr - (uint32_t)next) >= g->buflen);
+}
+
+/*
+ * Set the pass duration in ring mode on channel ch, this is the maximum latency of a buffer swap by gen_play()
+ * With us=0 a pass is one buffer, which is also the case without ring. The default is GEN_RINGUS.
+ * Takes effect from the next gen_play().
+ */
+void gen_passtime(int ch, uint32_t us)
+{
+	gen_ch_t *g = gen_get(ch);
+
+	if (g == NULL) return;
+	g->ringus = us;
+}
+
+/*
+ * Make buf the waveform of a channel, playing from the next period boundary
+ * When the channel was not looping it is restarted instead, taking over the samples from src first unless it is NULL.
+ */
+static void gen_setbuf(gen_ch_t *g, uint8_t *buf, wfg_t *wave, uint32_t len, const uint8_t *src, bool dac)
+{
+	uint32_t clkdiv;														// 31:16 int part, 15:8 frac part (in 1/256)
+	uint32_t save, pass, margin, cur;
+
+	/* Calculate PIO clock divider */
+	clkdiv = calc_playdiv(_fsys, wave->dur, len/gen_wid);
+	gen_unsweep(g);
+
+	/* Restart loop when streaming, or when the read ring changes */
+	if ((g->mode != GEN_LOOP) || (gen_ringsize(buf, len) != g->ring))
+	{
+		gen_unburst(g);
+		gen_stop(g);
+		g->wfg.buf = buf;
+		if (src != NULL)
+			gen_take(g, buf, src, len, dac);								// Copy, or correct in place
+		g->wfg.len = len;
+		g->wfg.dur = wave->dur;
+		g->pio->sm[g->sm].clkdiv = (io_rw_32)clkdiv;						// Set new value
+		pio_sm_clkdiv_restart(g->pio, g->sm);								// Restart clock
+		gen_loop(g);
+		return;
 	}
+	
+	/*
+	 * Swap buffers, when there is enough margin before the end of current pass
+	 * The margin covers GEN_SWAPCYC at the current divider, words take 4/gen_wid samples of div cycles each.
+	 * A pass that is too short for that is swapped in its first half, which is the best that can be done.
+	 */
+	pass = gen_pass(len, g->ring, clkdiv, g->ringus);						// Before the critical section
+	cur = g->pio->sm[g->sm].clkdiv;
+	margin = GEN_SWAPMARGIN + (GEN_SWAPCYC * gen_wid * 16384u) / cur;		// cur is in 1/65536
+	cur = gen_pass(g->wfg.len, g->ring, cur, g->ringus);					// Current pass
+	if (margin > cur/2) margin = (cur/2 < 1) ? 1 : cur/2;
+	while (true)
+	{
+		save = save_and_disable_interrupts();
+		if (dma_hw->ch[g->dma_data].transfer_count >= margin) break;		// Remaining words in current pass
+		restore_interrupts(save);
+	}
+	g->wfg.buf = buf;														// Reload address for next pass
+	dma_hw->ch[g->dma_data].transfer_count = pass;							// Reload value for next pass
+	g->pio->sm[g->sm].clkdiv = (io_rw_32)clkdiv;							// Set new value
+	restore_interrupts(save);
+	g->wfg.len = len;
+	g->wfg.dur = wave->dur;
+}
+
+/*
+ * Clip the length of a waveform to the buffer constraints, returns 0 when it cannot be played
+ */
+static uint32_t gen_wavelen(wfg_t *wave, uint32_t max)
+{
+	uint32_t len;
+
+	len = (uint32_t)wave->len; len &= ~3;									// Force multiple of 4
+	if (len>max) len = max;													// Truncate to maximum
+	if ((len<GEN_MINBUFLEN) && ((len<GEN_MINRINGLEN) || (len&(len-1)))) return 0;	// Insufficient samples, see gen_loop()
+	return len;
 }
 
 /*
  * This function is the main API of the generator on channel ch.
  * Parameters are a waveform samples buffer, its length and a desired frequency.
  * It is assumed that the buffer contains one wave, and the frequency will be maximized at fsys/buflen
+ * The samples are copied into the inactive buffer of the channel, while the DMA keeps on playing the active one.
+ * Then the reload values of the DMA loop are changed, so the new waveform starts at the next period boundary.
+ * Note that the new clock divider takes effect immediately, i.e. for the remainder of the current period.
+ * When the channel was streaming or idle, the DMA loop is restarted instead.
+ * In 16 bit mode, the samples are halfwords and only channel A is available.
+ * The copy is skipped when the samples were already written in place, see gen_loadbuf().
+ * With a correction table the samples are corrected while copying, or in place.
  */
+static void gen_load(int ch, wfg_t *wave, bool dac)
+{
+	gen_ch_t *g = gen_get(ch);
+	uint32_t len, t0;
+	uint8_t *next;
+
+	if (g == NULL) return;													// Channel not available
+	len = gen_wavelen(wave, g->buflen);
+	if (len == 0) return;
+	t0 = stats_begin();
+	
+	if (g->mode != GEN_LOOP)												// Restart in first buffer
+	{
+		gen_setbuf(g, g->buf[0], wave, len, wave->buf, dac);
+		stats_end(STATS_PLAY, t0);
+		return;
+	}
+	
+	/* Store waveform in inactive buffer */
+	next = gen_loadbuf(ch);
+	gen_take(g, next, wave->buf, len, dac);									// Copy samples from input
+	gen_setbuf(g, next, wave, len, NULL, dac);
+	stats_end(STATS_PLAY, t0);
+}
 void gen_play(int ch, wfg_t *wave)
 {
-	uint32_t clkdiv;														// 31:16 int part, 15:8 frac part (in 1/256)
+	gen_load(ch, wave, false);
+}
+
+/*
+ * As gen_play(), for samples that are DAC codes already, e.g. the output of a channel saved in a preset
+ */
+void gen_playdac(int ch, wfg_t *wave)
+{
+	gen_load(ch, wave, true);
+}
+
+/*
+ * Play the samples of wave on channel ch straight from wave->buf, without copying
+ * This is a pointer swap, the buffer must be 32 bit aligned and remain unchanged while in use, see gen_inuse().
+ * A channel with a correction table cannot play uncorrected samples, so then they are copied by gen_play().
+ */
+void gen_playref(int ch, wfg_t *wave)
+{
+	gen_ch_t *g = gen_get(ch);
 	uint32_t len;
-	float div;
 
-	ch &= 1;																// Truncate channel into range
-	len = (uint32_t)wave->len; len &= ~3;									// Force multiple of 4
-	if (len<GEN_MINBUFLEN) return;											// Insufficient samples
-	if (len>GEN_MAXBUFLEN) len = GEN_MAXBUFLEN;								// Truncate to maximum
+	if (g == NULL) return;
+	if ((g->cal != NULL) && (gen_wid == GEN_WIDTH8)) { gen_play(ch, wave); return; }
+	len = gen_wavelen(wave, gen_buflen);
+	if (len == 0) return;
+	gen_setbuf(g, wave->buf, wave, len, NULL, false);
+}
+
+/*
+ * Waveform that channel ch plays in loop mode, returns false in other modes
+ */
+bool gen_getwave(int ch, wfg_t *wave)
+{
+	gen_ch_t *g = gen_get(ch);
+
+	if ((g == NULL) || (g->mode != GEN_LOOP)) return false;
+	*wave = g->wfg;
+	return true;
+}
+
+/*
+ * Returns true when the DMA of a channel plays, or will play, from the n bytes at buf
+ * Note that after gen_playref() the previous buffer is still in use until the end of its pass.
+ */
+bool gen_inuse(uint8_t *buf, uint32_t n)
+{
+	gen_ch_t *g;
+	int ch, i;
+
+	for (ch=0; ch<GEN_NCH; ch++)
+	{
+		g = &gen_ch[ch];
+		if (g->mode == GEN_IDLE) continue;
+		if (g->mode == GEN_SEQ)												// Any segment
+			for (i=0; i<g->nseg; i++)
+				if (((uint32_t)g->seg[i].wave.buf - (uint32_t)buf) < n) return true;
+		if (((uint32_t)g->wfg.buf - (uint32_t)buf) < n) return true;		// Reload address
+		if ((dma_hw->ch[g->dma_data].read_addr - (uint32_t)buf) < n) return true;	// Current pass
+	}
+	return false;
+}
+
+/*
+ * Rotate n bytes in place over off positions, so that buf[i] becomes buf[i-off]
+ * Three reversals, so no scratch buffer is needed.
+ */
+static void gen_reverse(uint8_t *buf, uint32_t n)
+{
+	uint8_t t;
+	uint32_t i;
+
+	for (i=0; i<n/2; i++)
+	{
+		t = buf[i]; buf[i] = buf[n-1-i]; buf[n-1-i] = t;
+	}
+}
+static void gen_rotate(uint8_t *buf, uint32_t n, uint32_t off)
+{
+	gen_reverse(buf, n);
+	gen_reverse(buf, off);
+	gen_reverse(&buf[off], n-off);
+}
+
+/*
+ * Reset a stopped statemachine and restart its DMA loop from the start of the waveform, this fills the TX FIFO
+ */
+static void gen_prefill(gen_ch_t *g)
+{
+	pio_sm_restart(g->pio, g->sm);											// Clear shift counters
+	pio_sm_clear_fifos(g->pio, g->sm);
+	pio_sm_exec(g->pio, g->sm, pio_encode_out(pio_null, 32));				// Empty OSR, autopull on first out
+	gen_loop(g);															// DMA loop fills TX FIFO
+}
+
+/*
+ * Play waveforms on all channels, started simultaneously.
+ * Channel ch lags channel A by phase[ch] degrees, this is done by rotating its samples over phase/360 of its buffer.
+ * All statemachines are stopped, the DMA loops are restarted to pre-fill the TX FIFOs, and then the 
+ * statemachines are enabled and their clock dividers restarted with a single register write for each PIO.
+ * When the channels ended up in different PIOs, the pio0 channels are started first and then those of pio1.
+ * The outputs stop during reconfiguration, so unlike gen_play() this is not glitch-free.
+ * Not available in 16 bit mode.
+ */
+void gen_playsync(wfg_t *wave[GEN_NCH], const float *phase)
+{
+	gen_ch_t *g;
+	uint32_t len[GEN_NCH], off, mask[2];
+	uint8_t *next[GEN_NCH];
+	float ph;
+	int ch;
+
+	if (gen_wid == GEN_WIDTH16) return;
+	for (ch=0; ch<GEN_NCH; ch++)
+		if (!gen_alloc(ch, 0)) return;										// A pair is taken, see gen_alloc()
+	for (ch=0; ch<GEN_NCH; ch++)
+	{
+		gen_unburst(&gen_ch[ch]);
+		len[ch] = (uint32_t)wave[ch]->len; len[ch] &= ~3;					// Force multiple of 4
+		if (len[ch]<GEN_MINBUFLEN) return;									// Insufficient samples
+		if (len[ch]>gen_buflen) len[ch] = gen_buflen;						// Truncate to maximum
+		next[ch] = gen_loadbuf(ch);											// Before stopping, see gen_loadbuf()
+	}
 	
-	/* Calculate PIO clock divider */
-	div = _fsys * wave->dur / len;											// Sample rate to fsys ratio
-	if (div < 1.0) div=1.0; 												// Sample rate too high: top off
-	clkdiv = (uint32_t)div;													// Extract integer part
-	div = (div - clkdiv)*256;												// Fraction x 256
-	clkdiv = (clkdiv << 8) + (uint32_t)div;									// Add 8bit integer part of fraction
-	clkdiv = clkdiv << 8;													// Final shift to match required format
-
-	/* Store waveform */
-	dma_channel_abort(2*ch);												// Stop DMA transfers, to prevent collisions
-	dma_channel_abort(2*ch+1);
-	memcpy(wfg_ctrl[ch].buf, wave->buf, len);								// Copy samples from input
-	wfg_ctrl[ch].len = len;
-	wfg_ctrl[ch].dur = wave->dur;
-
-	/* Re-program PIO */
-	pio0_hw->sm[ch].clkdiv = (io_rw_32)clkdiv;								// Set new value
-	pio_sm_clkdiv_restart(pio0, ch);										// Restart clock
-	
-	/* Re-program DMA */
-	dma_hw->ch[2*ch].read_addr = (io_rw_32)wfg_ctrl[ch].buf;				// Read from waveform buffer
-	dma_hw->ch[2*ch].write_addr = (io_rw_32)&pio0->txf[ch];					// Write to PIO TX fifo
-	dma_hw->ch[2*ch].transfer_count = wfg_ctrl[ch].len/4;					// Nr of 32 bit words to transfer
-	dma_hw->ch[2*ch].al1_ctrl = DMA_DC(ch);									// Write ctrl word without starting the DMA
-	dma_hw->ch[2*ch+1].read_addr = (io_rw_32)&(wfg_ctrl[ch].buf);			// Read from waveform buffer address reference
-	dma_hw->ch[2*ch+1].write_addr = (io_rw_32)&dma_hw->ch[2*ch].read_addr;	// Write to data channel read address
-	dma_hw->ch[2*ch+1].transfer_count = 1;									// One word to transfer
-	dma_hw->ch[2*ch+1].ctrl_trig = DMA_CC(ch);								// Write ctrl word and start DMA
+	/* Stop statemachines and DMA */
+	for (ch=0; ch<GEN_NCH; ch++)
+	{
+		g = &gen_ch[ch];
+		pio_sm_set_enabled(g->pio, g->sm, false);
+		gen_stop(g);
+	}
+
+	/* Store waveforms in inactive buffers, so the active ones may be used as input, or rotate in place */
+	mask[0] = 0; mask[1] = 0;
+	for (ch=0; ch<GEN_NCH; ch++)
+	{
+		g = &gen_ch[ch];
+		ph = phase[ch] - 360.0*(int)(phase[ch]/360.0);						// Normalize phase
+		if (ph < 0.0) ph += 360.0;
+		off = (uint32_t)(ph * len[ch] / 360.0) % len[ch];					// Samples offset
+		if (next[ch] == wave[ch]->buf)										// Loaded in place
+		{
+			gen_take(g, next[ch], next[ch], len[ch], false);
+			if (off > 0) gen_rotate(next[ch], len[ch], off);
+		}
+		else
+		{
+			gen_take(g, next[ch], &wave[ch]->buf[len[ch]-off], off, false);	// next[i] = wave[i-off]
+			gen_take(g, &next[ch][off], wave[ch]->buf, len[ch]-off, false);
+		}
+		g->wfg.buf = next[ch];
+		g->wfg.len = len[ch];
+		g->wfg.dur = wave[ch]->dur;
+		g->pio->sm[g->sm].clkdiv = (io_rw_32)calc_playdiv(_fsys, wave[ch]->dur, len[ch]);
+		mask[(g->pio == pio0) ? 0 : 1] |= 1u<<g->sm;
+	}
+
+	/* Reset statemachines and pre-fill the TX FIFOs */
+	for (ch=0; ch<GEN_NCH; ch++)
+		gen_prefill(&gen_ch[ch]);
+	for (ch=0; ch<GEN_NCH; ch++)
+		while (!pio_sm_is_tx_fifo_full(gen_ch[ch].pio, gen_ch[ch].sm))
+			tight_loop_contents();
+	
+	/* Go */
+	if (mask[0]) pio_enable_sm_mask_in_sync(pio0, mask[0]);					// Enable and restart clocks
+	if (mask[1]) pio_enable_sm_mask_in_sync(pio1, mask[1]);
+}
+
+/*
+ * Stop channel ch and rewind its waveform, so that the next gen_enable() starts output at the first sample.
+ * The TX FIFO is pre-filled and the clock divider restarted, so output starts within a few SM clocks.
+ * This gives a deterministic start relative to other hardware that is started right after, see lcr.c.
+ * Only for a looping channel.
+ */
+void gen_arm(int ch)
+{
+	gen_ch_t *g = gen_get(ch);
+
+	if ((g == NULL) || (g->mode != GEN_LOOP)) return;
+	pio_sm_set_enabled(g->pio, g->sm, false);
+	gen_stop(g);
+	gen_prefill(g);
+	while (!pio_sm_is_tx_fifo_full(g->pio, g->sm))
+		tight_loop_contents();
+	pio_sm_clkdiv_restart(g->pio, g->sm);
+}
+
+/*
+ * Switch channel ch to streaming mode, with a sample rate of rate [Hz].
+ * The DMA is started once the producer has committed GEN_STRNBLK blocks.
+ * Until then, and after an underrun, the output is NOT valid.
+ * In 16 bit mode only channel A can stream, the blocks then contain halfword samples.
+ * Returns false when the channel is not available.
+ */
+bool gen_stream(int ch, float rate)
+{
+	gen_ch_t *g = gen_get(ch);
+	int i;
+
+	if (g == NULL) return false;
+	gen_unburst(g);
+	gen_stop(g);
+	
+	for (i=0; i<GEN_STRNBLK; i++)											// Initialize block address table
+		g->strtab[i] = g->buf[0] + i*GEN_STRBLKLEN;
+	g->strrd = 0;
+	g->strwr = 0;
+	g->strunder = 0;
+	g->wfg.buf = g->strtab[0];
+	g->wfg.len = GEN_STRBLKLEN;
+	g->wfg.dur = GEN_STRBLKLEN / gen_wid / rate;
+	
+	g->pio->sm[g->sm].clkdiv = (io_rw_32)calc_clkdiv(_fsys / rate);			// Set new value
+	pio_sm_clkdiv_restart(g->pio, g->sm);									// Restart clock
+
+	dma_hw->ch[g->dma_data].read_addr = (io_rw_32)g->strtab[0];				// Read from first block
+	dma_hw->ch[g->dma_data].write_addr = (io_rw_32)&g->pio->txf[g->sm];		// Write to PIO TX fifo
+	dma_hw->ch[g->dma_data].transfer_count = GEN_STRBLKLEN/4;				// Nr of 32 bit words in a block
+	dma_hw->ch[g->dma_data].al1_ctrl = g->sdc;								// Write ctrl word without starting the DMA
+	dma_hw->ch[g->dma_ctrl].read_addr = (io_rw_32)&g->strtab[1];			// Read from next block address in table
+	dma_hw->ch[g->dma_ctrl].write_addr = (io_rw_32)&dma_hw->ch[g->dma_data].read_addr;	// Write to data channel read address
+	dma_hw->ch[g->dma_ctrl].transfer_count = 1;								// One word to transfer
+	dma_hw->ch[g->dma_ctrl].al1_ctrl = g->scc;								// Write ctrl word without starting the DMA
+	g->mode = GEN_STREAM;
+	return true;
+}
+
+/*
+ * True while channel ch is in streaming mode, a producer stops when another command takes the channel
+ */
+bool gen_streaming(int ch)
+{
+	gen_ch_t *g = gen_get(ch);
+
+	return (g != NULL) && (g->mode == GEN_STREAM);
+}
+
+/*
+ * Change the sample rate of a streaming channel, without restarting it
+ */
+void gen_strrate(int ch, float rate)
+{
+	gen_ch_t *g = gen_get(ch);
+
+	if ((g == NULL) || (g->mode != GEN_STREAM)) return;
+	g->wfg.dur = GEN_STRBLKLEN / gen_wid / rate;
+	g->pio->sm[g->sm].clkdiv = (io_rw_32)calc_clkdiv(_fsys / rate);			// Set new value
+}
+
+/*
+ * Get the next free streaming block of channel ch, NULL if there is none.
+ * The block has GEN_STRBLKLEN bytes, and is handed to the DMA by gen_strcommit().
+ */
+uint8_t *gen_strblock(int ch)
+{
+	gen_ch_t *g = gen_get(ch);
+
+	if ((g == NULL) || (g->mode != GEN_STREAM)) return NULL;
+	if ((dma_hw->inte0 & (1u<<g->dma_data)) && ((int32_t)(g->strwr - g->strrd) <= 0))	// Underrun, as in gen_dmairq()
+		g->strwr = g->strrd + 1;											//  skip to block after playing one
+	if ((g->strwr - g->strrd) >= GEN_STRNBLK) return NULL;					// All blocks in use
+	return g->strtab[g->strwr%GEN_STRNBLK];
+}
+
+/*
+ * Commit the block obtained by gen_strblock(), the stream is started on the first complete ring
+ */
+void gen_strcommit(int ch)
+{
+	gen_ch_t *g = gen_get(ch);
+
+	if ((g == NULL) || (g->mode != GEN_STREAM)) return;
+	gen_take(g, g->strtab[g->strwr%GEN_STRNBLK], g->strtab[g->strwr%GEN_STRNBLK], GEN_STRBLKLEN, false);
+	g->strwr++;
+	if ((g->strrd == 0) && (g->strwr == GEN_STRNBLK))						// Ring is filled: go
+	{
+		dma_hw->ints0 = 1u<<g->dma_data;									// Clear pending interrupt
+		dma_hw->inte0 |= 1u<<g->dma_data;									// Count played blocks
+		dma_channel_start(g->dma_data);
+	}
+}
+
+/*
+ * Return the nr of underruns on streaming channel ch
+ */
+uint32_t gen_strunderrun(int ch)
+{
+	return gen_ch[(uint)ch%GEN_NCH].strunder;
+}
+
+/*
+ * Arm channel ch to play its current waveform n times on the next trigger, then hold the idle sample value.
+ * Until the trigger, the output keeps its last value. Re-arm by calling again.
+ * Only available in 8 bit mode.
+ */
+void gen_burst(int ch, uint32_t n, uint8_t idle)
+{
+	gen_ch_t *g = gen_get(ch);
+	uint32_t clkdiv, *cb;
+	uint32_t i;
+
+	if ((g == NULL) || (gen_wid == GEN_WIDTH16)) return;
+	if (n<1) n = 1;
+	if (n>GEN_MAXBURST) n = GEN_MAXBURST;
+
+	clkdiv = g->pio->sm[g->sm].clkdiv;										// Keep the sample rate
+	gen_stop(g);
+	if (g->mode == GEN_STREAM)												// Streaming ring is no waveform
+		g->wfg.len = GEN_STRBLKLEN;
+
+	/* Build control block table */
+	cb = g->btab;
+	for (i=0; i<n; i++)
+	{
+		*cb++ = g->wfg.len/4;												// Nr of words
+		*cb++ = (uint32_t)g->wfg.buf;										// Waveform samples
+	}
+	if (g->cal != NULL) idle = g->cal[idle];								// Level as DAC code
+	g->bidle = 0x01010101 * idle;
+	*cb++ = 1;																// One word
+	*cb++ = (uint32_t)&g->bidle;											//  of idle samples
+	*cb++ = 0;																// NULL trigger
+	*cb++ = 0;
+	
+	/* Restart SM with trigger program, it waits for the trigger edge */
+	wfgtrig_program_init(g->pio, g->sm, g->progtrig, g->pin, (uint)8, 1.0);
+	g->pio->sm[g->sm].clkdiv = (io_rw_32)clkdiv;
+	pio_sm_clkdiv_restart(g->pio, g->sm);
+	g->mode = GEN_BURST;
+
+	/* Start control blocks, the data channel fills the TX FIFO */
+	dma_hw->ch[g->dma_data].write_addr = (io_rw_32)&g->pio->txf[g->sm];		// Write to PIO TX fifo
+	dma_hw->ch[g->dma_data].al1_ctrl = g->dc;								// Write ctrl word without starting the DMA
+	dma_hw->ch[g->dma_ctrl].read_addr = (io_rw_32)g->btab;					// Read from control block table
+	dma_hw->ch[g->dma_ctrl].write_addr = (io_rw_32)&dma_hw->ch[g->dma_data].al3_transfer_count;	// Write to count and trigger
+	dma_hw->ch[g->dma_ctrl].transfer_count = 2;								// Two words per control block
+	dma_hw->ch[g->dma_ctrl].ctrl_trig = g->bcc;								// Write ctrl word and start DMA
+}
+
+/*
+ * Software trigger of an armed burst channel
+ */
+void gen_trigger(int ch)
+{
+	gen_ch_t *g = gen_get(ch);
+
+	if ((g == NULL) || (g->mode != GEN_BURST)) return;
+	pio_sm_exec(g->pio, g->sm, pio_encode_jmp(g->progtrig + wfgtrig_wrap_target));	// Skip the wait
+}
+
+/*
+ * Check whether a burst on channel ch has completed, i.e. the DMA chain has ended
+ */
+bool gen_burstdone(int ch)
+{
+	gen_ch_t *g = gen_get(ch);
+
+	if ((g == NULL) || (g->mode != GEN_BURST)) return true;
+	return (!dma_channel_is_busy(g->dma_data) && !dma_channel_is_busy(g->dma_ctrl));
+}
+
+/*
+ * Return the sample buffers of channel ch, so that sequence segments can be written in place.
+ * These are 2*gen_maxlen() contiguous bytes, NULL is returned for a channel that is not available.
+ * The channel keeps on playing from them, see gen_seqhold().
+ */
+uint8_t *gen_seqbuf(int ch)
+{
+	gen_ch_t *g = gen_get(ch);
+
+	if (g == NULL) return NULL;
+	return g->buf[0];
+}
+
+/*
+ * Write a sequence control block into the table at tab
+ */
+static uint32_t *gen_seqblk(uint32_t *tab, uint32_t ctrl, volatile void *src, volatile void *dst, uint32_t count)
+{
+	*tab++ = ctrl;															// Data channel alias 1: CTRL
+	*tab++ = (uint32_t)src;													//  READ_ADDR
+	*tab++ = (uint32_t)dst;													//  WRITE_ADDR
+	*tab++ = count;															//  TRANS_COUNT_TRIG
+	return tab;
+}
+
+/*
+ * Check whether nseg segments at seg can be played as a sequence on channel ch, without touching the output
+ * The segment waveforms need their final buffer address and length, not the samples. The reset channel is claimed 
+ * here, so a sequence that passes the check can be compiled by gen_seq().
+ */
+static bool gen_seqcheck(gen_ch_t *g, seg_t *seg, int nseg, bool loop)
+{
+	dma_channel_config c;
+	uint32_t div[GEN_MAXSEG];
+	uint32_t len, nblk, i;
+	int d;
+
+	if ((g == NULL) || (gen_wid == GEN_WIDTH16)) return false;
+	if ((nseg < 1) || (nseg > GEN_MAXSEG)) return false;
+	nblk = loop ? 0 : 1;													// NULL trigger block
+	for (i=0; i<nseg; i++)
+	{
+		len = gen_wavelen(&seg[i].wave, gen_buflen);
+		if ((len == 0) || (seg[i].n < 1)) return false;
+		div[i] = calc_playdiv(_fsys, seg[i].wave.dur, len/gen_wid);
+	}
+	for (i=0; i<nseg; i++)
+	{
+		len = gen_wavelen(&seg[i].wave, gen_buflen);
+		if (div[i] != div[(i>0) ? i-1 : (loop ? nseg-1 : 0)]) nblk++;		// Divider block
+		nblk += gen_ringsize(seg[i].wave.buf, len) ? 1 : seg[i].n;
+	}
+	if (nblk > GEN_SEQNBLK) return false;									// Does not fit
+	if (g->dma_seq < 0)														// First sequence: claim reset channel
+	{
+		d = dma_claim_unused_channel(false);
+		if (d < 0) return false;
+		g->dma_seq = d;
+		c = dma_channel_get_default_config((uint)d);						// One word, unpaced, CHAIN_TO=self
+		channel_config_set_read_increment(&c, false);
+		channel_config_set_high_priority(&c, true);
+		channel_config_set_irq_quiet(&c, true);
+		g->rcc = channel_config_get_ctrl_value(&c);
+	}
+	return true;
+}
+
+/*
+ * Check a sequence as gen_seq() does, and when it can be played stop channel ch, so the segments can be written.
+ * Returns false and leaves the channel playing otherwise.
+ */
+bool gen_seqhold(int ch, seg_t *seg, int nseg, bool loop)
+{
+	gen_ch_t *g = gen_get(ch);
+
+	if (!gen_seqcheck(g, seg, nseg, loop)) return false;
+	gen_unburst(g);
+	gen_stop(g);
+	g->mode = GEN_IDLE;
+	return true;
+}
+
+/*
+ * Play nseg segments on channel ch, each seg[i].n periods of seg[i].wave, and start over when loop is set.
+ * The segment list is compiled into control blocks, after which the transitions are timed by the DMA only.
+ * The segment buffers are played by reference, see gen_playref(), a segment waveform must be one period.
+ * Returns false when the sequence does not fit in GEN_SEQNBLK blocks, or no reset channel is free.
+ * The channel is then left as it was.
+ * Only available in 8 bit mode.
+ */
+bool gen_seq(int ch, seg_t *seg, int nseg, bool loop)
+{
+	gen_ch_t *g = gen_get(ch);
+	uint32_t *tab, *last;
+	uint32_t len, prev, ring, i, j;
+
+	if (!gen_seqcheck(g, seg, nseg, loop)) return false;
+	gen_unburst(g);
+	gen_stop(g);
+	
+	/* Compile the control block table */
+	for (i=0; i<nseg; i++)
+	{
+		g->seg[i] = seg[i];
+		len = gen_wavelen(&seg[i].wave, gen_buflen);
+		gen_take(g, seg[i].wave.buf, seg[i].wave.buf, len, false);			// Correct in place
+		g->seg[i].wave.len = len;
+		g->seqdiv[i] = calc_playdiv(_fsys, seg[i].wave.dur, len/gen_wid);
+	}
+	g->nseg = nseg;
+	tab = g->seqtab; last = tab;
+	for (i=0; i<nseg; i++)
+	{
+		prev = g->seqdiv[(i>0) ? i-1 : (loop ? nseg-1 : 0)];
+		len = g->seg[i].wave.len;
+		ring = gen_ringsize(g->seg[i].wave.buf, len);
+		if (g->seqdiv[i] != prev)											// New divider before first sample
+			tab = gen_seqblk(tab, g->ddc, &g->seqdiv[i], &g->pio->sm[g->sm].clkdiv, 1);
+		if (ring)															// All periods in one block
+		{
+			last = tab;
+			tab = gen_seqblk(tab, g->dc | (ring<<DMA_CH0_CTRL_TRIG_RING_SIZE_LSB), g->seg[i].wave.buf,
+							 &g->pio->txf[g->sm], g->seg[i].n * (len/4));
+		}
+		else
+			for (j=0; j<g->seg[i].n; j++)
+			{
+				last = tab;
+				tab = gen_seqblk(tab, g->dc, g->seg[i].wave.buf, &g->pio->txf[g->sm], len/4);
+			}
+	}
+	if (loop)																// Last data block chains to reset channel
+		last[0] = (last[0] & ~DMA_CH0_CTRL_TRIG_CHAIN_TO_BITS) | ((uint32_t)g->dma_seq<<DMA_CH0_CTRL_TRIG_CHAIN_TO_LSB);
+	else
+		gen_seqblk(tab, 0, NULL, NULL, 0);									// NULL trigger ends the chain
+	g->seqstart = (uint32_t)g->seqtab;
+	
+	/* Running waveform for other modes, the first segment */
+	g->wfg = g->seg[0].wave;
+	g->pio->sm[g->sm].clkdiv = (io_rw_32)g->seqdiv[0];
+	pio_sm_clkdiv_restart(g->pio, g->sm);
+
+	/* Reset channel, restarts dma_ctrl at the table */
+	dma_hw->ch[g->dma_seq].read_addr = (io_rw_32)&g->seqstart;				// Read table address
+	dma_hw->ch[g->dma_seq].write_addr = (io_rw_32)&dma_hw->ch[g->dma_ctrl].al3_read_addr_trig;	// Write to ctrl read address and trigger
+	dma_hw->ch[g->dma_seq].transfer_count = 1;								// One word to transfer
+	dma_hw->ch[g->dma_seq].al1_ctrl = g->rcc;								// Write ctrl word without starting the DMA
+
+	/* Start control blocks */
+	dma_hw->ch[g->dma_ctrl].read_addr = (io_rw_32)g->seqtab;				// Read from control block table
+	dma_hw->ch[g->dma_ctrl].write_addr = (io_rw_32)&dma_hw->ch[g->dma_data].al1_ctrl;	// Write to alias 1 registers
+	dma_hw->ch[g->dma_ctrl].transfer_count = 4;								// Four words per control block
+	dma_hw->ch[g->dma_ctrl].ctrl_trig = g->qcc;								// Write ctrl word and start DMA
+	g->mode = GEN_SEQ;
+	return true;
+}
+
+/*
+ * Check whether a sequence on channel ch has completed, always false for a looping sequence
+ */
+bool gen_seqdone(int ch)
+{
+	gen_ch_t *g = gen_get(ch);
+
+	if ((g == NULL) || (g->mode != GEN_SEQ)) return true;
+	return (!dma_channel_is_busy(g->dma_data) && !dma_channel_is_busy(g->dma_ctrl));
+}
+
+/*
+ * Sweep the frequency of looping channel ch, by writing the n PIO clkdiv register values in tab one after the 
+ * other, each for dwell seconds. The waveform keeps on playing, the first value is written immediately.
+ * After the last point the channel stays at that frequency, until the next gen_play().
+ * Returns false when the channel is not looping, dwell is over gen_maxdwell(), or no DMA channel is free.
+ */
+bool gen_sweep(int ch, uint32_t *tab, uint32_t n, float dwell)
+{
+	gen_ch_t *g = gen_get(ch);
+	dma_channel_config c;
+	pwm_config pc;
+	uint32_t cycles, div;
+	uint slice;
+	int d;
+
+	if ((g == NULL) || (g->mode != GEN_LOOP) || (n < 1)) return false;
+	if ((dwell <= 0.0) || (dwell > gen_maxdwell())) return false;			// One PWM wrap per point
+	if (g->dma_sweep < 0)													// First sweep: claim channel
+	{
+		d = dma_claim_unused_channel(false);
+		if (d < 0) return false;
+		g->dma_sweep = d;
+	}
+	slice = gen_slices[ch];
+	gen_unsweep(g);
+	g->swn = n;
+
+	/* PWM slice wraps every dwell seconds */
+	cycles = (uint32_t)(dwell * _fsys);
+	div = cycles/65536 + 1;													// Smallest integer divider
+	if (div > GEN_SWMAXDIV) div = GEN_SWMAXDIV;
+	if (cycles/div < 2) cycles = 2*div;
+	if (cycles/div > 65536) cycles = 65536*div;								// Rounding, see gen_maxdwell()
+	pc = pwm_get_default_config();
+	pwm_config_set_clkdiv_int(&pc, div);
+	pwm_config_set_wrap(&pc, (uint16_t)(cycles/div - 1));
+	pwm_init(slice, &pc, false);
+
+	/* Write table into clkdiv, one word on each wrap */
+	g->pio->sm[g->sm].clkdiv = (io_rw_32)tab[0];							// First point
+	if (n > 1)
+	{
+		c = dma_channel_get_default_config((uint)g->dma_sweep);			// Read increment, 32 bit
+		channel_config_set_write_increment(&c, false);
+		channel_config_set_dreq(&c, DREQ_PWM_WRAP0 + slice);
+		channel_config_set_irq_quiet(&c, true);
+		dma_channel_configure((uint)g->dma_sweep, &c, &g->pio->sm[g->sm].clkdiv, &tab[1], n-1, true);
+	}
+	pwm_set_enabled(slice, true);
+	return true;
 }
 
+/*
+ * Longest dwell time of a sweep point [s], a full PWM counter range at the largest integer divider
+ * This is about 134msec at 125MHz.
+ */
+float gen_maxdwell(void)
+{
+	return 65536.0f * GEN_SWMAXDIV / _fsys;
+}
+
+/*
+ * Index of the active sweep point on channel ch
+ */
+uint32_t gen_sweeppos(int ch)
+{
+	gen_ch_t *g = gen_get(ch);
+
+	if ((g == NULL) || (g->dma_sweep < 0) || (g->swn < 2)) return 0;
+	return g->swn - 1 - dma_hw->ch[g->dma_sweep].transfer_count;
+}
+
+/*
+ * Sample the hardware status of channel ch, clearing the sticky TX stall flag and DMA error bits
+ * Note that the TX FIFO also stalls legitimately, e.g. after a burst or when a stream is not fed.
+ * Returns false when the channel is not available.
+ */
+bool gen_hwstat(int ch, genhw_t *st)
+{
+	gen_ch_t *g = gen_get(ch);
+	uint32_t bit, ctrl;
+
+	if (g == NULL) return false;
+	st->mode = g->mode;
+	st->level = pio_sm_get_tx_fifo_level(g->pio, g->sm);
+	bit = 1u << (PIO_FDEBUG_TXSTALL_LSB + g->sm);
+	st->stall = ((g->pio->fdebug & bit) != 0);
+	g->pio->fdebug = bit;													// Write 1 to clear
+	st->err = 0;
+	ctrl = dma_hw->ch[g->dma_data].ctrl_trig;
+	if (ctrl & DMA_CH0_CTRL_TRIG_AHB_ERROR_BITS)
+	{
+		st->err |= 1;
+		dma_hw->ch[g->dma_data].al1_ctrl = ctrl;							// Write 1 to clear READ/WRITE_ERROR
+	}
+	ctrl = dma_hw->ch[g->dma_ctrl].ctrl_trig;
+	if (ctrl & DMA_CH0_CTRL_TRIG_AHB_ERROR_BITS)
+	{
+		st->err |= 2;
+		dma_hw->ch[g->dma_ctrl].al1_ctrl = ctrl;
+	}
+	st->reloads = g->reloads;
+	return true;
+}
+
+/*
+ * Start (on) or stop counting the dma_ctrl reloads of all channels in loop mode, from zero
+ * This takes an interrupt per reload, so it is meant for a short measurement window. Counting stops by itself
+ * after GEN_MAXCOUNT reloads, the count is then a lower bound of the rate. Other modes are not counted.
+ */
+void gen_count(bool on)
+{
+	gen_ch_t *g;
+	uint32_t ctrl;
+	int ch;
+
+	for (ch=0; ch<GEN_NCH; ch++)
+	{
+		g = &gen_ch[ch];
+		dma_hw->inte0 &= ~(1u<<g->dma_ctrl);
+		if (on) g->cc &= ~DMA_CH0_CTRL_TRIG_IRQ_QUIET_BITS;					// IRQ on each reload
+		else g->cc |= DMA_CH0_CTRL_TRIG_IRQ_QUIET_BITS;
+		if (g->mode == GEN_LOOP)											// Running loop, without error clear
+		{
+			ctrl = dma_hw->ch[g->dma_ctrl].ctrl_trig & ~(DMA_CH0_CTRL_TRIG_READ_ERROR_BITS|DMA_CH0_CTRL_TRIG_WRITE_ERROR_BITS);
+			dma_hw->ch[g->dma_ctrl].al1_ctrl = on ? (ctrl & ~DMA_CH0_CTRL_TRIG_IRQ_QUIET_BITS) : (ctrl | DMA_CH0_CTRL_TRIG_IRQ_QUIET_BITS);
+		}
+		if (!on) continue;
+		g->reloads = 0;
+		dma_hw->ints0 = 1u<<g->dma_ctrl;									// Clear pending interrupt
+		dma_hw->inte0 |= 1u<<g->dma_ctrl;
+	}
+}
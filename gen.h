@@ -11,9 +11,28 @@
  
 #define OUTA	0															// Channel A indicator
 #define OUTB	1															// Channel B indicator
+#define GEN_NCH	2															// Nr of output channels, see gen_pins[] in gen.c
 
 #define GEN_MINBUFLEN		  20											// Minimum nr of byte samples
-#define GEN_MAXBUFLEN		2000											// Maximum buffer size (byte samples)
+#define GEN_MINRINGLEN		   8											// Minimum for a power of two buffer, see gen_loop()
+#define GEN_RINGUS			1000											// Default pass duration in ring mode, usec
+#define GEN_MAXBUFLEN		2048											// Maximum buffer size (byte samples), power of 2
+#define GEN_POOLLEN			(2*GEN_NCH*GEN_MAXBUFLEN)						// Samplebuffer pool, see gen_maxlen()
+
+#define GEN_LOOP			0												// Channel modes: repeat one waveform buffer
+#define GEN_STREAM			1												//  or stream a ring of blocks
+#define GEN_STRNBLK			4												// Nr of streaming blocks, power of 2
+#define GEN_STRBLKLEN		(2*GEN_MAXBUFLEN/GEN_STRNBLK)					// Streaming block size (byte samples)
+#define GEN_IDLE			2												//  or stopped, until next gen_play()
+#define GEN_BURST			3												//  or play N periods on a trigger
+#define GEN_MAXBURST		256												// Maximum nr of periods in a burst
+#define GEN_SEQ				4												//  or play a sequence of segments
+#define GEN_MAXSEG			8												// Maximum nr of segments in a sequence
+#define GEN_SEQNBLK			64												// Nr of sequence control blocks, see gen_seq()
+#define GEN_MAXSWEEP		1024											// Maximum nr of sweep points
+
+#define GEN_WIDTH8			1												// Output width: two channels of 8 bit samples
+#define GEN_WIDTH16			2												//  or channel A only, 16 bit samples on 16 pins
 
 
 extern float _fsys;
@@ -22,19 +41,105 @@ extern float _fsys;
  * The structure that defines the waveform input to wfg_play.
  * Note that the buffer needs to contain 4N bytes, i.e. needs to be 32bit aligned.
  * For high frequencies, the minimum buffer length is in the order of 32 bytes (buflen=8).
+ * In 16 bit mode the buffer contains uint16_t samples, len still is the length in bytes.
  */
 typedef struct wfg
 {
 	uint8_t  *buf;															// Points to waveform buffer
-	uint32_t  len;															// Buffer length in byte samples
-	float     dur;															// Duration of buffer, in seconds
+	uint32_t  len;															// Buffer length in bytes
+	double    dur;															// Duration of buffer, in seconds
 } wfg_t;
 
-/* Initialize both channels */
+/*
+ * A sequence segment, n periods of wave
+ * The samples are played by reference, so the buffer must remain unchanged while the sequence plays.
+ */
+typedef struct seg
+{
+	wfg_t	  wave;															// Segment waveform, one period
+	uint32_t  n;															// Nr of periods
+} seg_t;
+
+/* Initialize both channels, with the default waveforms or those set before with gen_preset() */
 void gen_init(void);
+void gen_preset(int output, wfg_t *wave);									// 8 bit samples, copied by gen_init()
+
+/* DAC correction table of the channel indicated by output, applied to all samples taken over in 8 bit mode */
+#define GEN_CALLEN			256												// Table entries, one per code
+void gen_setcal(int output, const uint8_t *lut);							// NULL for none
+const uint8_t *gen_getcal(int output);
+
+/* Decode system clock frequency, and change it to khz [kHz] while keeping the output frequencies */
+#define GEN_MINKHZ		 48000												// System clock range [kHz], see gen_clock()
+#define GEN_MAXKHZ		266000												//  flash SPI clock stays at or below 133MHz
+float gen_getfsys(void);
+bool gen_clock(uint32_t khz);
+
+/* Select output width, GEN_WIDTH8 or GEN_WIDTH16, stops the outputs */
+void gen_width(int width);
+int gen_getwidth(void);
 
 /* Play a waveform on the channel indicated by output */
 void gen_play(int output, wfg_t *wave);
+void gen_playdac(int output, wfg_t *wave);									// Samples are DAC codes, not corrected
+uint8_t *gen_loadbuf(int output);											// Buffer for in place samples
+bool	 gen_loadfree(int output);											// True when gen_loadbuf() does not wait
+void	 gen_passtime(int output, uint32_t us);								// Ring mode pass duration, 0 for one buffer
+uint32_t gen_maxlen(void);													// Buffer size in bytes, GEN_MAXBUFLEN or twice that in 16 bit mode
+bool	 gen_alloc(int output, uint32_t len);								// Buffers of len bytes, taking the idle partner pair
+uint32_t gen_alloclen(void);												// Maximum len for gen_alloc()
+void gen_playref(int output, wfg_t *wave);									// Play without copying
+bool gen_getwave(int output, wfg_t *wave);									// Waveform playing in loop mode
+bool gen_inuse(uint8_t *buf, uint32_t n);
 
+/* Start or stop the channel indicated by output, and query its actual divider and sample rate */
+void gen_enable(int output, bool on);
+float gen_getdiv(int output);
+float gen_getrate(int output);
+
+/* Play waveforms on all channels, started in sync and with channel ch lagging A by phase[ch] degrees */
+void gen_playsync(wfg_t *wave[GEN_NCH], const float *phase);
+void gen_arm(int output);													// Stop and rewind, gen_enable() starts at sample 0
+
+/* Stream blocks of samples on the channel indicated by output */
+bool gen_stream(int output, float rate);
+bool gen_streaming(int output);
+void gen_strrate(int output, float rate);
+uint8_t *gen_strblock(int output);
+void gen_strcommit(int output);
+uint32_t gen_strunderrun(int output);
+
+/* Sequence of segments on the channel indicated by output, repeated when loop is set */
+bool gen_seq(int output, seg_t *seg, int nseg, bool loop);
+bool gen_seqdone(int output);
+uint8_t *gen_seqbuf(int output);											// 2*gen_maxlen() bytes for segments, still playing
+bool gen_seqhold(int output, seg_t *seg, int nseg, bool loop);				// Check sequence and stop, to write segments
+
+/* Frequency sweep on the channel indicated by output, n clkdiv values for dwell [s] each */
+#define GEN_SWMAXDIV		255												// Largest PWM divider pacing a sweep
+bool gen_sweep(int output, uint32_t *tab, uint32_t n, float dwell);
+float gen_maxdwell(void);													// Dwell limit [s], for the current clock
+uint32_t gen_sweeppos(int output);
+
+/* Burst mode, play current waveform n times on a trigger on the channel indicated by output */
+void gen_burst(int output, uint32_t n, uint8_t idle);
+void gen_trigger(int output);
+bool gen_burstdone(int output);
+
+/*
+ * Hardware status of a channel, see gen_hwstat()
+ * The stall flag and the DMA error bits are sticky in hardware, and are cleared by sampling.
+ */
+typedef struct
+{
+	int		 mode;															// Channel mode
+	uint32_t level;															// TX FIFO level, in words
+	bool	 stall;															// TX FIFO ran empty since last sample
+	uint32_t err;															// DMA AHB_ERROR bits: 1=data, 2=ctrl
+	uint32_t reloads;														// dma_ctrl reloads counted, see gen_count()
+} genhw_t;
+#define GEN_MAXCOUNT	100000												// Reload interrupts before gen_count() gives up
+bool gen_hwstat(int output, genhw_t *st);
+void gen_count(bool on);													// Count loop mode reloads on DMA_IRQ_0
 
 #endif
\ No newline at end of file
@@ -9,6 +9,7 @@
 
 #include <stdio.h>
 #include <string.h>
+#include <math.h>
 #include "pico/stdlib.h"
 #include "pico/sem.h"
 #include "hardware/i2c.h"
@@ -22,15 +23,13 @@
 #include "hmi.h"
 #include "gen.h"
 #include "lcd.h"
+#include "core1.h"
+#include "sched.h"
+#include "lcr.h"
+#include "preset.h"
 
 /** Some generic identifiers **/
 // Mode strings
-#define HMI_SQR			0
-#define HMI_TRI			1
-#define HMI_SAW			2
-#define HMI_SIN			3
-#define HMI_PUL			4
-#define HMI_NMODE		5
 uint8_t *hmi_chmode[HMI_NMODE]  = { LCD_SQR24X12, LCD_TRI24X12, LCD_SAW24X12, LCD_SIN24X12, LCD_PUL24X12};
 
 // Unit strings
@@ -47,85 +46,18 @@ uint8_t *hmi_chdur[HMI_NUNIT] = {"usec", "msec"};
 uint8_t *hmi_chpul[HMI_NPUL] = {"Duty", "Rise", "Fall"};
 
 
-/** Channel A/B wave definition structures **/
-extern uint8_t sine[GEN_MAXBUFLEN];											// Full sine waveform
-typedef struct
-{
-	int 	mode;															// Waveform type
-	float 	time;															// Duration, in seconds
-	int 	duty;															// Duty cycle, percentage of duration
-	int		rise;															// Rise time, percentage of duration
-	int 	fall;															// Fall time, percentage of duration
-} ch_t;
+/** Channel A/B wave definitions **/
 ch_t hmi_chdef[2];
-uint8_t hmi_wave[GEN_MAXBUFLEN];											// Scratch buffer for waveform samples
-
-// Generate waveform samples in scratch buffer
-// Division factor should end-up above 4 to get a <0.1% deviation
-// so: fsample < fsys/4, implying a bufferlength of maximum time*fsys/4.
-// This is about 50 samples per usec, but this length should be minimized too
-// which means that for times smaller than a few usec the frequency will be less accurate.
-// Simple waveforms can be calculated, for Sine wave there is a lookup-table
+
+// Post channel definition to the generator service on core 1
 void hmi_genwave(int ch)
 {
-	int i;
-	uint32_t d, r, f;
-	float step;
-	wfg_t wf;
-	
-	// Calculate optimum nr of samples
-	wf.len = (uint32_t)((_fsys/1) * hmi_chdef[ch].time);					// Calculate required nr of samples
-	wf.len &= ~3;															// Multiple of 4 bytes
-	if (wf.len<20) wf.len = 20;												// Minimum size
-	if (wf.len>GEN_MAXBUFLEN) wf.len = GEN_MAXBUFLEN;						// Maximum size
-	
-	// Fill array
+	c1cmd_t cmd;
 
-	switch (hmi_chdef[ch].mode)
-	{
-	case HMI_SQR:
-		memset(&hmi_wave[0],0xff, wf.len/2); 								// High half samples
-		memset(&hmi_wave[wf.len/2],0x00, wf.len/2);							// Low half samples
-		break;
-	case HMI_TRI:
-		step = 255.0/(wf.len/2);											// Calculate slope (step per sample)
-		for (i=0; i<wf.len/2; i++)
-		{
-			hmi_wave[i] = (uint8_t)(i*step);								// Samples way up
-			hmi_wave[i+wf.len/2] = 255 - hmi_wave[i];						// Samples way down
-		}
-		break;
-	case HMI_SAW:
-		step = 255.0/(wf.len);												// Calculate slope (step per sample)
-		for (i=0; i<wf.len; i++)
-			hmi_wave[i] = (uint8_t)(i*step);								// Samples rising side
-		break;
-	case HMI_SIN:
-		step = (float)GEN_MAXBUFLEN/wf.len;									// Step to next sine index
-		for (i=0; i<wf.len; i++)
-			hmi_wave[i] = sine[(int)(i*step)];								// Truncate i*step to get index
-		break;
-	case HMI_PUL:
-		d = hmi_chdef[ch].duty * wf.len / 100;								// Fraction of duty cycle samples
-		r = hmi_chdef[ch].rise * wf.len / 100;								// Fraction of rising flank samples
-		f = hmi_chdef[ch].fall * wf.len / 100;								// Fraction of falling flank samples
-		step = 255.0/r;														// Calculate rise slope (step per sample)
-		for (i=0; i<r; i++)
-			hmi_wave[i] = (uint8_t)(i*step);								// Samples way up
-		for (i=r; i<d; i++)
-			hmi_wave[i] = 0xff;												// High samples
-		step = 255.0/f;														// Calculate fall slope (step per sample)
-		for (i=0; i<f; i++)
-			hmi_wave[i+d] = 0xff-i*step;									// Samples way down
-		for (i=d+f; i<wf.len; i++)
-			hmi_wave[i] = 0x00;												// Low samples
-		break;
-	}
-	
-	// Play waveform
-	wf.buf = hmi_wave;
-	wf.dur = hmi_chdef[ch].time;
-	gen_play(ch, &wf);
+	cmd.cmd = CORE1_DEF;
+	cmd.ch = ch;
+	cmd.def = hmi_chdef[ch];
+	core1_post(&cmd);
 }
 
 /** Channel setting menu **/
@@ -319,8 +251,71 @@ int hmi_menu = HMI_M_LCR;													// Current active menu
 int par;																	// Current active menu parameter
 int channel;																// Current active channel
 
+/** LCR measurement menu **/
+#define HMI_NLCRF		4													// Nr of stimulus frequencies
+double   hmi_lcrf[HMI_NLCRF] = {1.0e3, 1.0e4, 5.0e4, 1.0e5};
+uint8_t *hmi_lcrfstr[HMI_NLCRF] = {"1kHz  ", "10kHz ", "50kHz ", "100kHz"};
+int      hmi_lcrsel = 0;													// Selected stimulus frequency
+
+// Format v with an SI prefix and unit, in at most 4 digits
+void hmi_eng(char *s, float v, char *unit)
+{
+	const char pfx[] = "pnum kMG";
+	int i = 4;
+
+	if (isinf(v)) { sprintf(s, "open"); return; }
+	while ((fabsf(v) >= 1000.0) && (i < 7)) { v /= 1000.0; i++; }
+	while ((fabsf(v) < 1.0) && (v != 0.0) && (i > 0)) { v *= 1000.0; i--; }
+	if (pfx[i] == ' ')
+		sprintf(s, "%.4g%s", v, unit);
+	else
+		sprintf(s, "%.4g%c%s", v, pfx[i], unit);
+}
+
+// Write measurement result in scratch area
+void hmi_lcrshow(lcr_t *res)
+{
+	char s[24], v[12];
+
+	lcd_clrscr(0,50,128,44);
+	hmi_eng(v, (float)res->freq, "Hz"); sprintf(s, "f  %s", v);
+	lcd_puts(  4, 52, s, LCD_6X8, false);
+	hmi_eng(v, res->r, "Ohm"); sprintf(s, "R  %s", v);
+	lcd_puts(  4, 62, s, LCD_6X8, false);
+	if (res->x >= 0.0)
+		{ hmi_eng(v, res->l, "H"); sprintf(s, "L  %s", v); }
+	else
+		{ hmi_eng(v, res->c, "F"); sprintf(s, "C  %s", v); }
+	lcd_puts(  4, 72, s, LCD_6X8, false);
+	hmi_eng(v, res->x, "Ohm"); sprintf(s, "X  %s", v);
+	lcd_puts(  4, 82, s, LCD_6X8, false);
+	sprintf(s, "%.1f", res->phase);
+	lcd_puts( 86, 82, s, LCD_6X8, false);
+}
+
+// Frequency selection with UP and DOWN, CENTER starts a measurement
 void hmi_lcrmenu(int key)
 {
+	switch(key)
+	{
+	case HMI_TOP:															// Entering menu
+		lcd_puts(  4, 36, "Freq", LCD_8X12, false);
+		lcd_puts( 48, 38, hmi_lcrfstr[hmi_lcrsel], LCD_6X8, true);
+		break;
+	case HMI_UP:
+		hmi_lcrsel = (hmi_lcrsel<HMI_NLCRF-1)?hmi_lcrsel+1:0;
+		lcd_puts( 48, 38, hmi_lcrfstr[hmi_lcrsel], LCD_6X8, true);
+		break;
+	case HMI_DOWN:
+		hmi_lcrsel = (hmi_lcrsel>0)?hmi_lcrsel-1:HMI_NLCRF-1;
+		lcd_puts( 48, 38, hmi_lcrfstr[hmi_lcrsel], LCD_6X8, true);
+		break;
+	case HMI_CENTER:
+		if (lcr_start(hmi_lcrf[hmi_lcrsel], SCHED_HMI) == 0.0) break;		// Busy
+		lcd_clrscr(0,50,128,44);
+		lcd_puts(  4, 52, "Measuring", LCD_6X8, false);
+		break;																// Result in hmi_evaluate()
+	}
 }
 
 void hmi_chmenu(int key)
@@ -392,18 +387,119 @@ void hmi_handler(int key)
 }
 
 
-/** Called from main loop at regular intervals **/
-void hmi_evaluate()
+/** 
+ * Keypad input
+ * The PCF8574 INT output goes low when an input changes, and is released by reading the PCF8574.
+ * The GPIO IRQ on INT only marks that a read is due and posts SCHED_HMI, so an idle keypad costs nothing.
+ * A changed key state is accepted when it is still the same after HMI_DEBOUNCE msec. 
+ * Navigation keys that are held auto-repeat, after HMI_REPDELAY and then every HMI_REPRATE msec.
+ * Accepted key presses go into a small event queue, which is handed to hmi_handler() from the main loop.
+ * An alarm posts SCHED_HMI for debounce and auto-repeat. A separate alarm retries when the display flush holds the
+ * bus, it only posts SCHED_HMI again, so the debounce and repeat deadlines are not moved.
+ **/
+#define HMI_INTPIN		19													// PCF8574 INT, active low
+#define HMI_DEBOUNCE	20													// Stable time before accepting, msec
+#define HMI_REPDELAY	500													// Auto-repeat delay, msec
+#define HMI_REPRATE		100													// Auto-repeat interval, msec
+#define HMI_RETRY		1													// Bus busy retry, msec
+#define HMI_REPKEYS		(HMI_UP|HMI_DOWN|HMI_LEFT|HMI_RIGHT)				// Keys that may repeat
+#define HMI_NKEYQ		8													// Event queue size, power of 2
+
+volatile bool hmi_kread;													// PCF8574 read is due
+volatile bool hmi_ktmo;														// Debounce or repeat time is due
+alarm_id_t    hmi_kalarm;													// Pending alarm, 0 if none
+alarm_id_t    hmi_kretry;													// Pending bus busy retry, 0 if none
+uint8_t       hmi_kcand;													// Key state candidate, while debouncing
+bool          hmi_kdeb;														// Debouncing
+uint8_t       hmi_keyq[HMI_NKEYQ];											// Key event queue
+uint32_t      hmi_keyhd, hmi_keytl;											// Queue head and tail counters
+
+void hmi_kirq(uint gpio, uint32_t events)
+{
+	hmi_kread = true;
+	sched_post(SCHED_HMI);
+}
+
+int64_t hmi_kalarmcb(alarm_id_t id, void *user_data)
+{
+	hmi_kalarm = 0;
+	hmi_ktmo = true;
+	sched_post(SCHED_HMI);
+	return 0;																// No reschedule
+}
+
+static void hmi_ksched(uint32_t ms)
+{
+	if (hmi_kalarm > 0) cancel_alarm(hmi_kalarm);
+	hmi_kalarm = add_alarm_in_ms(ms, hmi_kalarmcb, NULL, true);
+}
+
+int64_t hmi_kretrycb(alarm_id_t id, void *user_data)
+{
+	hmi_kretry = 0;
+	sched_post(SCHED_HMI);													// hmi_kread and hmi_ktmo are kept
+	return 0;
+}
+
+static void hmi_kput(uint8_t key)
+{
+	if ((hmi_keyhd - hmi_keytl) >= HMI_NKEYQ) return;						// Full: drop
+	hmi_keyq[hmi_keyhd++ % HMI_NKEYQ] = key;
+}
+
+/*
+ * Read the keypad when due, and queue the resulting key events
+ */
+static void hmi_kscan(void)
 {
 	uint8_t rxdata[4];
 	uint8_t key;
-	static bool firsttime = true;
+	bool tmo;
 
-	// Get key status
-	i2c_read_blocking(i2c0, I2C_PCF8574, rxdata, 1, false);					// Poll PCF8574
+	if (!hmi_kread && !hmi_ktmo) return;									// Nothing to do
+	if (lcd_busy())															// I2C in use by display flush
+	{
+		if (hmi_kretry <= 0) hmi_kretry = add_alarm_in_ms(HMI_RETRY, hmi_kretrycb, NULL, true);
+		return;
+	}
+	tmo = hmi_ktmo;
+	hmi_kread = false; hmi_ktmo = false;
+	i2c_read_blocking(i2c0, I2C_PCF8574, rxdata, 1, false);					// Read PCF8574, releases INT
 	key = rxdata[0] ^ 0xff;													// Take XOR for selection
-	if (key == keystat) return;												// No change: so bail out
-	if (firsttime) 															// Initialize screen
+
+	if (key != hmi_kcand)													// (Still) bouncing: restart debounce
+	{
+		hmi_kcand = key;
+		hmi_kdeb = true;
+		hmi_ksched(HMI_DEBOUNCE);
+		return;
+	}
+	if (hmi_kdeb)															// Stable: accept
+	{
+		if (!tmo) return;													// Wait for debounce time
+		hmi_kdeb = false;
+		if (key == keystat) return;											// Bounced back
+		keystat = key;														// Remember this key event
+		if (key == HMI_NOKEY) { if (hmi_kalarm > 0) cancel_alarm(hmi_kalarm); hmi_kalarm = 0; return; }
+		hmi_kput(key);
+		if (key & HMI_REPKEYS) hmi_ksched(HMI_REPDELAY);
+		return;
+	}
+	if (tmo && (key == keystat) && (key & HMI_REPKEYS))						// Held: auto-repeat
+	{
+		hmi_kput(key);
+		hmi_ksched(HMI_REPRATE);
+	}
+}
+
+/** Called by the scheduler on keypad events **/
+void hmi_evaluate()
+{
+	static bool firsttime = true;
+	lcr_t res;
+
+	hmi_kscan();
+	if (firsttime && (!LCD_SPLASH || (hmi_keytl != hmi_keyhd)))				// Initialize screen, after a splash on a key
 	{ 
 		lcd_clrscr(0,0,128,128);
 		lcd_putg(0, 0, LCD_UDJAT32, false);
@@ -413,17 +509,27 @@ void hmi_evaluate()
 		lcd_hruler(0, 126, 128);
 		firsttime = false; 
 	}
-	hmi_handler(key);
-	keystat = key;															// Remember this key event
+	while (hmi_keytl != hmi_keyhd)
+		hmi_handler(hmi_keyq[hmi_keytl++ % HMI_NKEYQ]);
+	if ((hmi_menu == HMI_M_LCR) && lcr_result(&res))						// Measurement done
+		hmi_lcrshow(&res);
 }
 
 void hmi_init()
 {
+	const prrec_t *pr;
 	uint8_t rxdata[4];
 	
 	// Get key status
 	i2c_read_blocking(i2c0, I2C_PCF8574, rxdata, 1, false);					// Get PCF8574 byte
 	keystat = rxdata[0] ^ 0xff;												// Initialize keystat
+	hmi_kcand = keystat;
+	gpio_init(HMI_INTPIN);
+	gpio_set_dir(HMI_INTPIN, GPIO_IN);
+	gpio_pull_up(HMI_INTPIN);												// INT is open drain
+	gpio_set_irq_enabled_with_callback(HMI_INTPIN, GPIO_IRQ_EDGE_FALL, true, hmi_kirq);
+	if (!gpio_get(HMI_INTPIN)) hmi_kread = true;							// Changed meanwhile
+
 	hmi_chdef[0].mode = HMI_SQR;											// Waveform type
 	hmi_chdef[0].time = 1.001e-6f;											// Duration, in seconds
 	hmi_chdef[0].duty = 50;													// Duty cycle, percentage of duration
@@ -434,4 +540,10 @@ void hmi_init()
 	hmi_chdef[1].duty = 50;													// Duty cycle, percentage of duration
 	hmi_chdef[1].rise = 50;													// Rise time, percentage of duration
 	hmi_chdef[1].fall = 50;													// Fall time, percentage of duration
+	pr = preset_get(PRESET_BOOT);
+	if (pr != NULL)															// Restored at boot instead
+	{
+		hmi_chdef[0] = pr->def[0];
+		hmi_chdef[1] = pr->def[1];
+	}
 }
\ No newline at end of file
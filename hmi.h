@@ -9,8 +9,25 @@
  * See hmi.c for more information 
  */
 
+/** Waveform modes **/
+#define HMI_SQR			0
+#define HMI_TRI			1
+#define HMI_SAW			2
+#define HMI_SIN			3
+#define HMI_PUL			4
+#define HMI_NMODE		5
 
-#endif
+/** Channel A/B wave definition structure **/
+typedef struct
+{
+	int 	mode;															// Waveform type
+	float 	time;															// Duration, in seconds
+	int 	duty;															// Duty cycle, percentage of duration
+	int		rise;															// Rise time, percentage of duration
+	int 	fall;															// Fall time, percentage of duration
+} ch_t;
 
 void hmi_init(void);
-void hmi_evaluate(void);
\ No newline at end of file
+void hmi_evaluate(void);
+
+#endif
@@ -0,0 +1,46 @@
+/*
+ * host.c
+ *
+ * Created: Jan 2022
+ * Author: Arjan te Marvelde
+ *
+ * Host hardware layer.
+ *
+ * On the Pico, gen.c owns the output hardware and tells the synthesis and planning code the system clock,
+ * the sample width and the buffer size. On a host those are plain variables, set by host_init().
+ * The system clock is derived from the PLL settings with calc.c, exactly like gen_getfsys() does from the
+ * registers, so the frequency plans are the same as on the Pico.
+ */
+
+#include "pico/stdlib.h"
+
+#include "gen.h"
+#include "calc.h"
+#include "host.h"
+
+float _fsys = 125.0e6;														// System clock frequency
+int   host_wid = GEN_WIDTH8;												// Output width, in bytes per sample
+
+
+bool host_init(uint32_t khz, int width)
+{
+	uint32_t fbdiv, pd1, pd2;
+
+	if (!calc_pll(khz, &fbdiv, &pd1, &pd2)) return false;
+	_fsys = calc_fsys(fbdiv, pd1, pd2);
+	host_wid = width;
+	return true;
+}
+
+int gen_getwidth(void)
+{
+	return host_wid;
+}
+
+/*
+ * Buffer size as divided by gen_alloc()
+ */
+uint32_t gen_maxlen(void)
+{
+	return (host_wid == GEN_WIDTH16) ? GEN_POOLLEN/2 : GEN_POOLLEN/(2*GEN_NCH);
+}
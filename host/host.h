@@ -0,0 +1,15 @@
+#ifndef __HOST_H__
+#define __HOST_H__
+/*
+ * host.h
+ *
+ * Created: Jan 2022
+ * Author: Arjan te Marvelde
+ *
+ * See host.c for more information
+ */
+
+/* Set the system clock to khz [kHz] and the sample width, returns false when the clock cannot be made */
+bool host_init(uint32_t khz, int width);
+
+#endif
@@ -0,0 +1,19 @@
+#ifndef __HOST_STDLIB_H__
+#define __HOST_STDLIB_H__
+/*
+ * pico/stdlib.h, host version
+ *
+ * Created: Jan 2022
+ * Author: Arjan te Marvelde
+ *
+ * Stands in for the SDK header when the hardware independent modules are compiled on a host,
+ * see uwfg_host.c. Only the types are provided, these modules do not touch the hardware.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef unsigned int uint;
+
+#endif
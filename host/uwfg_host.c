@@ -0,0 +1,234 @@
+/*
+ * uwfg_host.c
+ *
+ * Created: Jan 2022
+ * Author: Arjan te Marvelde
+ *
+ * Host tool, runs the synthesis and frequency planning code natively, see host.c.
+ *
+ * Usage: uwfg_host [-k <khz>] [-w 8|16] <command>
+ *   plan <freq> [nmin] [ppm]					Frequency plan, as the monitor plan command
+ *   wave <mode> <freq> [duty rise fall]		Samples of the planned buffer, one per line
+ *   golden [ref]								Plan and CRC32 of the samples over a fixed matrix, or compare with ref
+ *   bench [reps]								Synthesis time per sample, for each mode
+ * The golden output is meant to be kept, and diffed after a change of the synthesis or planning code:
+ * any difference in samples, dividers or frequency error shows up as a changed line.
+ * The reference outputs are in host/golden8.txt and host/golden16.txt, ctest runs the compare for both widths.
+ * With a ref file the differing lines go to stderr, and the exit code is 1 on any difference.
+ * The divider column is the PIO register value that gen_play() derives from the plan, with calc_playdiv().
+ */
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "pico/stdlib.h"
+
+#include "gen.h"
+#include "hmi.h"
+#include "plan.h"
+#include "synth.h"
+#include "calc.h"
+#include "host.h"
+
+static const char *host_mode[HMI_NMODE] = {"sqr", "tri", "saw", "sin", "pul"};
+static const double host_freq[] = {1.0, 50.0, 1000.0, 12345.678, 100000.0, 1.0e6, 3.3e6, 1.0e7};
+#define HOST_NFREQ		(sizeof(host_freq)/sizeof(host_freq[0]))
+
+uint8_t host_buf[2*GEN_MAXBUFLEN] __attribute__((aligned(4)));
+FILE    *host_ref = NULL;													// Golden reference, NULL to print
+int      host_ndiff = 0;
+
+
+/*
+ * CRC32 of n bytes, MSB first with the IEEE 802.3 polynomial
+ */
+static uint32_t host_crc(const uint8_t *p, uint32_t n)
+{
+	uint32_t crc = 0xffffffff;
+	int i;
+
+	while (n--)
+	{
+		crc ^= (uint32_t)(*p++) << 24;
+		for (i=0; i<8; i++)
+			crc = (crc & 0x80000000) ? (crc << 1) ^ 0x04c11db7 : (crc << 1);
+	}
+	return crc;
+}
+
+static int host_getmode(const char *s)
+{
+	int m;
+
+	for (m=0; m<HMI_NMODE; m++)
+		if (strcmp(s, host_mode[m]) == 0) return m;
+	return -1;
+}
+
+/*
+ * Plan and synthesize def at freq into host_buf
+ */
+static void host_synth(ch_t *def, double freq, plan_t *pl, wfg_t *wf)
+{
+	def->time = (float)(1.0/freq);
+	plan_find(freq, PLAN_NMIN, PLAN_MAXPER, PLAN_TOL, pl);
+	wf->buf = host_buf;
+	synth_plan(def, wf, pl);
+}
+
+static void host_plan(int argc, char **argv)
+{
+	plan_t pl;
+	uint32_t nmin = PLAN_NMIN;
+	float tol = PLAN_TOL;
+	double f;
+
+	if (argc<2) return;
+	f = atof(argv[1]);
+	if (f<=0.0) return;
+	if (argc>2) nmin = atoi(argv[2]);
+	if (argc>3) tol = atof(argv[3]);
+	if (nmin<2) nmin = 2;
+	plan_find(f, nmin, PLAN_MAXPER, tol, &pl);
+	printf("per=%u k=%u len=%u div=%.4f%s f=%.6f ppm=%.3f clkdiv=0x%08x\n", pl.per, pl.k, pl.n*gen_getwidth(),
+		   pl.div/256.0, ((pl.div&0xff)==0)?"(int)":"", pl.freq, pl.ppm, calc_playdiv(_fsys, plan_dur(&pl), pl.n));
+}
+
+static void host_wave(int argc, char **argv)
+{
+	ch_t def = {HMI_SIN, 0.0, 50, 10, 10};
+	plan_t pl;
+	wfg_t wf;
+	uint32_t i;
+
+	if (argc<3) return;
+	if ((def.mode = host_getmode(argv[1])) < 0) return;
+	if (argc>3) def.duty = atoi(argv[3]);
+	if (argc>4) def.rise = atoi(argv[4]);
+	if (argc>5) def.fall = atoi(argv[5]);
+	host_synth(&def, atof(argv[2]), &pl, &wf);
+	for (i=0; i<pl.n; i++)
+		printf("%u\n", (gen_getwidth() == GEN_WIDTH16) ? ((uint16_t *)host_buf)[i] : host_buf[i]);
+}
+
+/*
+ * Print a golden output line, or compare it with the next line of host_ref
+ */
+static void host_line(const char *fmt, ...)
+{
+	char line[256], ref[256];
+	va_list ap;
+
+	va_start(ap, fmt);
+	vsnprintf(line, sizeof(line), fmt, ap);
+	va_end(ap);
+	if (host_ref == NULL)
+	{
+		fputs(line, stdout);
+		return;
+	}
+	if (fgets(ref, sizeof(ref), host_ref) == NULL) ref[0] = '\0';
+	if (strcmp(line, ref) != 0)
+	{
+		fprintf(stderr, "- %s+ %s", (ref[0]=='\0') ? "(end)\n" : ref, line);
+		host_ndiff++;
+	}
+}
+
+static int host_golden(int argc, char **argv)
+{
+	ch_t def = {HMI_SQR, 0.0, 50, 10, 10};
+	plan_t pl;
+	wfg_t wf;
+	char ref[256];
+	uint32_t i;
+	int m;
+
+	if ((argc>1) && ((host_ref = fopen(argv[1], "r")) == NULL))
+	{
+		fprintf(stderr, "Cannot open %s\n", argv[1]);
+		return 1;
+	}
+	host_line("# fsys=%.0f width=%d\n", _fsys, 8*gen_getwidth());
+	host_line("mode,freq,per,k,len,div,clkdiv,f,ppm,crc\n");
+	for (m=0; m<HMI_NMODE; m++)
+		for (i=0; i<HOST_NFREQ; i++)
+		{
+			def.mode = m;
+			host_synth(&def, host_freq[i], &pl, &wf);
+			host_line("%s,%.3f,%u,%u,%u,%u,0x%08x,%.6f,%.3f,0x%08x\n", host_mode[m], host_freq[i], pl.per, pl.k, wf.len,
+					  pl.div, calc_playdiv(_fsys, wf.dur, wf.len/gen_getwidth()), pl.freq, pl.ppm, host_crc(host_buf, wf.len));
+		}
+	if (host_ref == NULL) return 0;
+	while (fgets(ref, sizeof(ref), host_ref) != NULL)						// Lines missing from the output
+	{
+		fprintf(stderr, "- %s+ (end)\n", ref);
+		host_ndiff++;
+	}
+	fclose(host_ref);
+	if (host_ndiff > 0) fprintf(stderr, "%d lines differ from %s\n", host_ndiff, argv[1]);
+	return (host_ndiff > 0) ? 1 : 0;
+}
+
+static void host_bench(int argc, char **argv)
+{
+	ch_t def = {HMI_SQR, 0.0, 50, 10, 10};
+	plan_t pl;
+	wfg_t wf;
+	struct timespec t0, t1;
+	double ns;
+	int m, r, reps = 1000;
+
+	if (argc>1) reps = atoi(argv[1]);
+	if (reps<1) reps = 1;
+	printf("mode,len,ns_per_sample\n");
+	for (m=0; m<HMI_NMODE; m++)
+	{
+		def.mode = m;
+		def.time = (float)(gen_maxlen() / gen_getwidth() / _fsys);			// One period fills the buffer
+		plan_find(1.0/def.time, PLAN_NMIN, 1, PLAN_TOL, &pl);
+		wf.buf = host_buf;
+		clock_gettime(CLOCK_MONOTONIC, &t0);
+		for (r=0; r<reps; r++)
+			synth_plan(&def, &wf, &pl);
+		clock_gettime(CLOCK_MONOTONIC, &t1);
+		ns = (t1.tv_sec - t0.tv_sec)*1.0e9 + (t1.tv_nsec - t0.tv_nsec);
+		printf("%s,%u,%.3f\n", host_mode[m], wf.len, ns / reps / pl.n);
+	}
+}
+
+int main(int argc, char **argv)
+{
+	uint32_t khz = 125000;
+	int width = GEN_WIDTH8;
+
+	argc--; argv++;
+	while ((argc>1) && (argv[0][0]=='-'))									// Options with a value
+	{
+		if (strcmp(argv[0], "-k")==0) khz = atoi(argv[1]);
+		else if (strcmp(argv[0], "-w")==0) width = (atoi(argv[1])==16) ? GEN_WIDTH16 : GEN_WIDTH8;
+		argc -= 2; argv += 2;
+	}
+	if (!host_init(khz, width))
+	{
+		fprintf(stderr, "No PLL setting for %u kHz\n", khz);
+		return 1;
+	}
+	if (argc<1)
+	{
+		fprintf(stderr, "Usage: uwfg_host [-k <khz>] [-w 8|16] plan <freq> [nmin] [ppm] | wave <mode> <freq> [duty rise fall] | golden [ref] | bench [reps]\n");
+		return 1;
+	}
+	if (strcmp(argv[0], "plan")==0) host_plan(argc, argv);
+	else if (strcmp(argv[0], "wave")==0) host_wave(argc, argv);
+	else if (strcmp(argv[0], "golden")==0) return host_golden(argc, argv);
+	else if (strcmp(argv[0], "bench")==0) host_bench(argc, argv);
+	else
+	{
+		fprintf(stderr, "Unknown command %s\n", argv[0]);
+		return 1;
+	}
+	return 0;
+}
@@ -1,21 +1,13 @@
 /*
- * lcd.c
+ * lcd-SH1106.c
  *
  * Created: Jan 2022
  * Author: Arjan te Marvelde
  * 
- * 
- * Driver for SSD1306 or SSD1309 or SH1106 OLED LCD module
- * It is an output-only MMI, so only write is supported
- * For now only 5x7 ASCII font, character mode, i.e. grid of 6x8 sized fields
- * Screen is 128x64 pixels, so that makes 21x8 character positions
- * Character position is the display location (X,Y) coordinate
- *
- * Functions are:
- * lcd_write()		Write ASCII to current position. (truncate at right border or next line?)
- * lcd_ctrl()		LCD settings, e.g. current cursor position, clear screen, ...
- * lcd_init()		Initializes interface, sets cursor to (0,0), etc
- * lcd_evaluate()	Can be called regularly to update LCD with canvas changes
+ * Display backend for SSD1306 or SSD1309 or SH1106 OLED LCD module, see lcd.c for the canvas.
+ * Screen is 128x64 monochrome pixels, the 128x128 greyscale canvas is rendered on it by taking the even rows:
+ * display row i is canvas row 2*i, a pixel is lit when its grey value is 8 or more. Combining row pairs instead
+ * would merge the adjacent strokes of the 6x8 and 8x12 fonts into solid blocks.
  *
  * buffer contents:
  * control byte + following bytes
@@ -28,24 +20,8 @@
  *   0xc0: single data
  *
  * Display is 128 columns wide by 8 pages (=64 pixels) high. Each (column, page) is a segment byte. LSB is top and MSB is bottom.
- * So one 6x8 character box has 6 bytes:
- * +--+--+--+--+--+--+
- * |b0|b0|b0|b0|b0|b0|
- * +--+--+--+--+--+--+
- * |b1|b1|b1|b1|b1|b1|
- * +--+--+--+--+--+--+
- * |b2|b2|b2|b2|b2|b2|
- * +--+--+--+--+--+--+
- * |b3|b3|b3|b3|b3|b3|
- * +--+--+--+--+--+--+
- * |b4|b4|b4|b4|b4|b4|
- * +--+--+--+--+--+--+
- * |b5|b5|b5|b5|b5|b5|
- * +--+--+--+--+--+--+
- * |b6|b6|b6|b6|b6|b6|
- * +--+--+--+--+--+--+
- * |b7|b7|b7|b7|b7|b7|
- * +--+--+--+--+--+--+
+ * So one page covers 16 canvas rows, the whole page is rendered and sent when one of these rows is dirty:
+ * a page address command followed by a 128 byte data burst.
  */
  
 #include <string.h>
@@ -95,112 +71,75 @@
 
 #define I2C_SH1106			0x3C											// I2C address (0x3C)
 
-#define LCD_DELAY			1000											// Screen refresh time
-		
-#define LCD_WIDTH			0x80											// Pixels or Columns
-#define LCD_HEIGHT			0x40											// Pixels
-#define LCD_PAGES			(LCD_HEIGHT/0x08)								// Character rows
-#define LCD_ROWLEN			(LCD_WIDTH/0x06)								// Character cols
+#define LCD_PWIDTH			0x80											// Pixels or Columns
+#define LCD_PHEIGHT			0x40											// Pixels
+#define LCD_PAGES			(LCD_PHEIGHT/0x08)								// Pages of 8 pixel rows
+#ifndef LCD_COLOFS
+#define LCD_COLOFS			0x02											// First column: SH1106 has 132 columns, 0 for SSD1306/SSD1309
+#endif
 
 #define LCD_CTRLCMD			0x00											// Control byte for burst commands
 #define LCD_CTRLDATA		0x40											// Control byte for burst data
 #define LCD_CTRLSINGLE		0x80											// OR in case of single command or data
 
-
-uint8_t lcd_canvas[LCD_HEIGHT/8][LCD_WIDTH+1];
-
-uint8_t lcd_xch, lcd_ych;													// Location of display (0-20, 0-7)
-
-	
+uint16_t lcd_tx[LCD_PAGES*(4+1+LCD_PWIDTH)];								// data_cmd words: per page commands + data
 
 
-// Write to canvas starting at (lcd_xch, lcd_ych)
-void lcd_puts(char *buf, int font)
+/*
+ * Render the display pages covering canvas rows r0..r1, and send them, returns the last canvas row sent
+ * Canvas row 2*i makes display row i, the low nibble of a canvas byte is the left pixel.
+ */
+int lcd_hw_flush(int c0, int c1, int r0, int r1)
 {
-	uint8_t *sptr;
-	char *bptr;
-	int i,j;
+	uint16_t *tx;
+	uint8_t *row, lo, hi;
+	int page, i, j;
 	
-	bptr = buf;
-	while ((lcd_xch < LCD_ROWLEN) && (*bptr != 0))
+	tx = lcd_tx;
+	for (page=r0/16; page<=r1/16; page++)
 	{
-		switch(font)
+		*tx++ = LCD_CTRLCMD;												// 0x00, control byte
+		*tx++ = LCD_SETPAGE | page;											// Set row
+		*tx++ = LCD_SETCOL_LO | (LCD_COLOFS&0x0f);							// Column 0
+		*tx++ = (LCD_SETCOL_HI | (LCD_COLOFS>>4)) | I2C_IC_DATA_CMD_STOP_BITS;
+		*tx++ = LCD_CTRLDATA;												// Data burst
+		for (j=0; j<LCD_FBW; j++)											// Two columns per canvas byte
 		{
-			case LCD_FONTSMALL:												// Arial, 6x8
-				if ((*bptr<0x00) || (*bptr>0x7f)) break;
-				sptr = &lcd_canvas[lcd_ych][1+lcd_xch*6];
-				for (i=0; i<6; i++)
-					*sptr++ = ASCII6x8[6*(*bptr)+i];
-				bptr++;														// next char
-				lcd_xch++;													// move cursor
-				break;
-			case LCD_FONTLARGE:												// Comic sans, 24x32
-				if ((*bptr<0x20) || (*bptr>0x3f)) break;
-				for (j=0; j<4; j++)
-				{
-					sptr = &lcd_canvas[lcd_ych+j][1+lcd_xch*6];
-					for (i=0; i<24; i++)
-						*sptr++ = ASCII24x32[96*((*bptr) - 0x20) + i + 24*j];
-				}
-				bptr++;														// next char
-				lcd_xch+=4;													// move cursor
-				break;
-			case LCD_FONTUDJAT:												// Udjat logo, 32x32
-				for (j=0; j<4; j++)
-				{
-					sptr = &lcd_canvas[lcd_ych+j][1+lcd_xch*6];
-					for (i=0; i<32; i++)
-						*sptr++ = UDJAT32x32[i + 32*j];
-				}
-				bptr++;														// next char
-				lcd_xch+=4;													// move cursor
-				break;
-				
+			lo = 0; hi = 0;
+			for (i=0; i<8; i++)												// Segment bit i
+			{
+				row = lcd_fb[page*16 + 2*i];								// Even canvas row
+				if (row[j] & 0x08) lo |= (1<<i);							// Left pixel
+				if (row[j] & 0x80) hi |= (1<<i);							// Right pixel
+			}
+			*tx++ = lo;
+			*tx++ = hi;
 		}
+		*(tx-1) |= I2C_IC_DATA_CMD_STOP_BITS;								// End of transaction
 	}
+	lcd_xfer(I2C_SH1106, lcd_tx, tx-lcd_tx);
+	return (r1/16)*16 + 15;													// Whole pages
 }
 
-// Control functions
-void lcd_ctrl(uint8_t cmd, uint8_t x, uint8_t y)
+/*
+ * Switch display on or off
+ */
+void lcd_hw_display(bool on)
 {
-	int page;
-	uint8_t txdata[16], *iptr;
+	uint8_t txdata[2];
 	
-	switch (cmd)
-	{
-		case LCD_GOTO:														// Set cursor position for next write
-			lcd_xch = MIN(x, LCD_ROWLEN-1);									// Cursor X location (0..20)
-			lcd_ych = MIN(y, LCD_PAGES-1);									// Cursor Y location (0..7)
-			break;
-			
-		case LCD_UPDATE:													// Flush scratch RAM to display RAM
-			txdata[0] = LCD_CTRLCMD;										// 0x00, control byte
-			txdata[1] = LCD_SETCOL_LO | 0x00;								// Column 0
-			txdata[2] = LCD_SETCOL_HI | 0x00;								//
-			for (page=0; page<LCD_PAGES; page++)
-			{
-				txdata[3] = LCD_SETPAGE | page;								// Set row
-				i2c_write_blocking(i2c0, I2C_SH1106, txdata, 4, false);		// Set position to (0,page) and write line
-				i2c_write_blocking(i2c0, I2C_SH1106, &lcd_canvas[page][0], (uint16_t)(LCD_WIDTH+1), false);	
-			}
-			break;
-			
-		case LCD_CLRSCR:
-			for (page=0; page<LCD_PAGES; page++)
-				memset(&lcd_canvas[page][1], 0x00, LCD_WIDTH);
-			lcd_xch = x; 
-			lcd_ych = y;
-			break;
-	}
+	txdata[0] = LCD_CTRLCMD;												// 0x00, control byte
+	txdata[1] = LCD_SETDISPLAY | (on?0x01:0x00);
+	i2c_write_blocking(i2c0, I2C_SH1106, txdata, 2, false);
 }
 
-/** Initialize LCD and clear canvas **/
-void lcd_init()
+/*
+ * Initialize display, leaves it switched off
+ */
+void lcd_hw_init(void)
 {
-	int page;
-	uint8_t txdata[16], *iptr;
+	uint8_t txdata[16];
 	
-	iptr = txdata;
 	txdata[0] = LCD_CTRLCMD;												// 0x00, control byte
 	txdata[1] = LCD_SETDISPLAY | 0x00;										// DISPLAY OFF
 	txdata[2] = LCD_SETADC | 0x01;											// Left rotation
@@ -210,25 +149,5 @@ void lcd_init()
 	txdata[6] = LCD_SETREVERSE | 0x00;										// Normal video
 	txdata[7] = LCD_CHARGEPUMP;												// Charge pump control
 	txdata[8] = 0x14;														// Enable
-	txdata[9] = LCD_SETDISPLAY | 0x01;										// DISPLAY ON
-	
-	i2c_write_blocking(i2c0, I2C_SH1106, txdata, 10, false);
-	
-	for (page=0; page<LCD_PAGES; page++)
-		lcd_canvas[page][0] = LCD_CTRLDATA;									// First byte indicates data xfer
-		
-	lcd_ctrl(LCD_CLRSCR, 0, 0);												// Clear screen, go to (0,0)
-
-	// Udjat logo in left upper corner
-	txdata[0] = 0x20;														// Construct one char dummy string
-	txdata[1] = 0x00;
-	lcd_ctrl(LCD_GOTO, 0, 0);
-	lcd_puts(txdata, 2);
-	lcd_ctrl(LCD_UPDATE, 0, 0);	
+	i2c_write_blocking(i2c0, I2C_SH1106, txdata, 9, false);
 }
-
-/** Transfer canvas to LCD **/
-void lcd_evaluate()
-{
-	lcd_ctrl(LCD_UPDATE, 0, 0);
-}
\ No newline at end of file
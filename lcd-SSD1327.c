@@ -0,0 +1,150 @@
+/*
+ * lcd-SSD1327.c
+ *
+ * Created: Jan 2022
+ * Author: Arjan te Marvelde
+ * 
+ * Display backend for SSD1327 based 128x128 greyscale display, see lcd.c for the canvas.
+ *
+ * I2C write sequence:
+ * control byte + following bytes
+ * control byte = 0bxy000000, where 
+ *   x: single (1) or multiple (0) 
+ *   y: data(1) or control(0)
+ *
+ * Display is 128 columns wide by 128 rows high. Each (col, row) is a grey value nibble [1-15]. 
+ * The nibbles are organized in display RAM as follows:
+ * +-----+-----+-----+-----+-----+-----+ ~ +-----+-----+
+ * |L   0 H   0|L   1 H   1|L   2 H   2|   |L  63 H  63|
+ * +-----+-----+-----+-----+-----+-----+ ~ +-----+-----+
+ * |L  64 H  64|L  65 H  65|L  66 H  66|   |L 127 H 127|
+ * +-----+-----+-----+-----+-----+-----+ ~ +-----+-----+
+ * /     /     /     /     /     /     /   /     /     /
+ * \     \     \     \     \     \     \   \     \     \
+ * +-----+-----+-----+-----+-----+-----+ ~ +-----+-----+
+ * |L8128 H8128|L8129 H8129|L8130 H8130|   |L8191 H8191|
+ * +-----+-----+-----+-----+-----+-----+ ~ +-----+-----+
+ *
+ *
+ * For writing Display RAM, first the conditions and start location are set (commands) then followed by a data burst.
+ *
+ * The canvas has the same layout as the display RAM, so a flush is a window command for the dirty rectangle,
+ * followed by a data burst containing the canvas bytes. It is sent in chunks of at most LCD_CHUNK rows, so the
+ * transfer list is 2KB instead of twice the canvas; lcd_flush() sends the next chunk after each DMA completion.
+ */
+ 
+#include <string.h>
+#include <stdio.h>
+#include "pico/stdlib.h"
+#include "hardware/i2c.h"
+#include "lcd.h"
+
+//		Command definition		   D	Function (reset values)
+//		SSD1327 				   #
+// ----------------------------------------------------------------------------------------------------------------------------
+#define LCD_WINCOLADDR	0x15	// 2	Sets first and last column for window (0x00, 0x3F).
+#define LCD_WINROWADDR	0x75	// 2	Sets first and last row for window (0x00, 0x7F).
+
+#define LCD_SCR_RIGHT	0x26	// 7	Setup right-scrolling part of display (see below)
+#define LCD_SCR_LEFT	0x27	// 7	Setup left-scrolling part of display
+#define LCD_SCR_STOP	0x2e	// 0	Stop scrolling window
+#define LCD_SCR_START	0x2f	// 0	Start scrolling window
+
+#define LCD_CONTRAST	0x81	// 1	Sets Contrast of the display (0x7F).
+#define LCD_REMAP		0xa0	// 1	Enables/Disables address remapping (0x00).
+#define LCD_DSTARTLINE	0xa1	// 1	Sets display start line (0x00).
+#define LCD_DOFFSET		0xa2	// 1	Sets display vertical offset (0x00).
+#define LCD_MODENORM	0xa4	// 0	Display in normal mode
+#define LCD_MODEWHITE	0xa5	// 0	Display all pixels white, greyscale=15
+#define LCD_MODEBLACK	0xa6	// 0	Display all pixels black, greyscale=0
+#define LCD_MODEINVERS	0xa7	// 0	Display all pixels inverted, greyscale=15-val
+#define LCD_MUXRATIO	0xa8	// 1	Set ratio to X+1, X>14, (0x7f)
+#define LCD_FASELECT	0xab	// 0	Select internal Vdd regulator when 1, external when 0 (0x01)
+
+#define LCD_INACTIVE	0xae	// 0	Switches display to sleep mode
+#define LCD_ACTIVE		0xaf	// 0	Switches display on, normal mode
+
+#define LCD_PHASELEN	0xb1	// 1	High nibble phase2, low nibbel phase1 (0x74)
+#define LCD_NOP1		0xb2	// 0	No operation
+#define LCD_OSC_D_F		0xb3	// 1	Set oscillator divider (0x00)
+#define LCD_GPIO		0xb5	// 1	(0x02)
+#define LCD_PCPER2		0xb6	// 1	(0x04)
+#define LCD_GS_TABLE	0xb8	// 15	Pulse width for GS levels 1..15, all unequal and value rising
+#define LCD_GS_LINEAR	0xb9	// 0	Sets linear GS table (default)
+#define LCD_NOP2		0xbb	// 0	No operation
+#define LCD_PCLEVEL		0xbc	// 1	(0x05)
+#define LCD_CDLEVEL		0xbe	// 1	(0x05)
+#define LCD_FBSELECT	0xd5	// 1	(0x00)
+#define LCD_CMDLOCK		0xfd	// 1	Lock OLED command interface (0x16) or unlock (0x12)
+
+
+#define I2C_SSD1327		0x3c												// I2C address (0x3C)
+#define LCD_CTRLCMD		0x00												// Control byte for burst commands
+#define LCD_CTRLDATA	0x40												// Control byte for burst data
+#define LCD_CTRLSINGLE	0x80												// OR in case of single command/data
+#define LCD_CTRLMULTI	0x00												// OR in case of multibyte command/data
+
+
+#define LCD_CHUNK		16													// Max nr of rows in one transfer
+
+uint16_t lcd_tx[7+1+LCD_CHUNK*LCD_FBW];										// data_cmd words: commands + data
+
+
+/*
+ * Send canvas bytes (c0..c1, r0..r1) to the display window, at most LCD_CHUNK rows, returns the last row sent
+ */
+int lcd_hw_flush(int c0, int c1, int r0, int r1)
+{
+	uint16_t *tx;
+	int i, j;
+	
+	if (r1 >= r0+LCD_CHUNK) r1 = r0+LCD_CHUNK-1;							// Rest in the next flush
+	tx = lcd_tx;
+	*tx++ = LCD_CTRLCMD | LCD_CTRLMULTI;									// Multiple command byte
+	*tx++ = LCD_WINCOLADDR;													// Set window columns
+	*tx++ = c0;																// left
+	*tx++ = c1;																// right
+	*tx++ = LCD_WINROWADDR;													// Set window rows
+	*tx++ = r0;																// top
+	*tx++ = r1 | I2C_IC_DATA_CMD_STOP_BITS;									// bottom, end of transaction
+	*tx++ = LCD_CTRLDATA | LCD_CTRLMULTI;									// Multiple data byte
+	for (i=r0; i<=r1; i++)
+		for (j=c0; j<=c1; j++)
+			*tx++ = lcd_fb[i][j];
+	*(tx-1) |= I2C_IC_DATA_CMD_STOP_BITS;									// End of transaction
+	lcd_xfer(I2C_SSD1327, lcd_tx, tx-lcd_tx);
+	return r1;
+}
+
+/*
+ * Switch display on or off (sleep)
+ */
+void lcd_hw_display(bool on)
+{
+	uint8_t txdata[2];
+	
+	txdata[0] = LCD_CTRLCMD | LCD_CTRLSINGLE;
+	txdata[1] = on?LCD_ACTIVE:LCD_INACTIVE;
+	i2c_write_blocking(i2c0, I2C_SSD1327, txdata, 2, false);				// Send commands
+}
+
+/*
+ * Initialize display, leaves it switched off
+ */
+void lcd_hw_init(void)
+{
+	uint8_t txdata[10];
+	
+	txdata[0] = LCD_CTRLCMD | LCD_CTRLMULTI ;								// Multiple command byte
+	txdata[1] = LCD_CMDLOCK;												// Unlock command interface
+	txdata[2] = 0x12;
+	txdata[3] = LCD_CTRLCMD | LCD_CTRLMULTI ;								// Multiple command byte
+	txdata[4] = LCD_REMAP;													// Display upside-down
+	txdata[5] = 0x53;														// So change GDRAM mapping
+	txdata[6] = LCD_CTRLCMD | LCD_CTRLSINGLE ;								// Multiple command byte	
+	txdata[7] = LCD_ACTIVE;													// DISPLAY ON
+	txdata[8] = LCD_CTRLCMD | LCD_CTRLSINGLE ;								// Multiple command byte	
+	txdata[9] = LCD_MODENORM;												// NORMAL MODE
+	i2c_write_blocking(i2c0, I2C_SSD1327, txdata, 10, false);
+	lcd_hw_display(false);
+}
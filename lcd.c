@@ -4,7 +4,7 @@
  * Created: Jan 2022
  * Author: Arjan te Marvelde
  * 
- * Driver for SSD1327 based 128x128 display.
+ * Display canvas, for SSD1327 based 128x128 or SH1106 based 128x64 display.
  * 
  * It is an output-only MMI, so only write is supported
  *
@@ -14,6 +14,8 @@
  * lcd_putg(int x, int y, uint8_t *bitmap);
  * lcd_clrscr(void);
  * lcd_init(void);
+ * lcd_flush(void);
+ * lcd_busy(void);
  * The parameters (x, y) determine upper left corner of object item, should be even numbers.
  * The font or bitmap object itself contains other parameters like (w, h) and the item data content.
  * (w, h) also should be even numbers.
@@ -29,104 +31,142 @@
  * A predefined bitmap is for example the Udjat logo, but user defined bitmap can also be dumped on display.
  * For filling the bitmap dynamically, several graphics functions are provided:
  *
- * I2C write sequence:
- * control byte + following bytes
- * control byte = 0bxy000000, where 
- *   x: single (1) or multiple (0) 
- *   y: data(1) or control(0)
- *
- * Display is 128 columns wide by 128 rows high. Each (col, row) is a grey value nibble [1-15]. 
- * The nibbles are organized in display RAM as follows:
- * +-----+-----+-----+-----+-----+-----+ ~ +-----+-----+
- * |L   0 H   0|L   1 H   1|L   2 H   2|   |L  63 H  63|
- * +-----+-----+-----+-----+-----+-----+ ~ +-----+-----+
- * |L  64 H  64|L  65 H  65|L  66 H  66|   |L 127 H 127|
- * +-----+-----+-----+-----+-----+-----+ ~ +-----+-----+
- * /     /     /     /     /     /     /   /     /     /
- * \     \     \     \     \     \     \   \     \     \
- * +-----+-----+-----+-----+-----+-----+ ~ +-----+-----+
- * |L8128 H8128|L8129 H8129|L8130 H8130|   |L8191 H8191|
- * +-----+-----+-----+-----+-----+-----+ ~ +-----+-----+
- *
- *
- * For writing Display RAM, first the conditions and start location are set (commands) then followed by a data burst.
+ * The canvas is 128 columns wide by 128 rows high. Each (col, row) is a grey value nibble [0-15], two per byte. 
+ * The low nibble is the left (even) column, as in the SSD1327 display RAM.
  *
+ * The drawing functions only write in this shadow framebuffer, and extend a dirty rectangle. 
+ * Each change posts SCHED_LCD, the scheduler then runs lcd_flush() to have the display backend send the dirty part.
+ * The backend is selected at compile time, see CMakeLists.txt:
+ * - lcd-SSD1327.c for a 128x128 greyscale display, a window with canvas bytes
+ * - lcd-SH1106.c for a 128x64 monochrome display, the canvas is rendered in full pages
+ * The backend builds its transfer as a list of halfwords for the I2C data_cmd register, the STOP bit of the last
+ * byte of each burst ends an I2C transaction, and the next byte in the FIFO starts a new one. 
+ * The transfer is done by DMA, paced by the I2C TX DREQ, so the CPU only has to build the transfer. 
+ * A backend may send fewer rows than asked, to keep its transfer list small; the rest stays dirty for the next flush.
+ * While a flush is in progress, lcd_busy() returns true and the I2C bus must not be used otherwise.
+ * The DMA completion interrupt starts an alarm that posts SCHED_LCD when the I2C FIFO has drained, for the next flush.
+ * lcd_init() does not wait for the first frame: the display is switched on by lcd_flush() once it has been sent,
+ * so start-up continues while the (splash) frame is transferred.
  */
  
 #include <string.h>
 #include <stdio.h>
 #include "pico/stdlib.h"
 #include "hardware/i2c.h"
+#include "hardware/dma.h"
+#include "hardware/irq.h"
 #include "lcd.h"
+#include "sched.h"
+#include "stats.h"
 
-//		Command definition		   D	Function (reset values)
-//		SSD1327 				   #
-// ----------------------------------------------------------------------------------------------------------------------------
-#define LCD_WINCOLADDR	0x15	// 2	Sets first and last column for window (0x00, 0x3F).
-#define LCD_WINROWADDR	0x75	// 2	Sets first and last row for window (0x00, 0x7F).
-
-#define LCD_SCR_RIGHT	0x26	// 7	Setup right-scrolling part of display (see below)
-#define LCD_SCR_LEFT	0x27	// 7	Setup left-scrolling part of display
-#define LCD_SCR_STOP	0x2e	// 0	Stop scrolling window
-#define LCD_SCR_START	0x2f	// 0	Start scrolling window
-
-#define LCD_CONTRAST	0x81	// 1	Sets Contrast of the display (0x7F).
-#define LCD_REMAP		0xa0	// 1	Enables/Disables address remapping (0x00).
-#define LCD_DSTARTLINE	0xa1	// 1	Sets display start line (0x00).
-#define LCD_DOFFSET		0xa2	// 1	Sets display vertical offset (0x00).
-#define LCD_MODENORM	0xa4	// 0	Display in normal mode
-#define LCD_MODEWHITE	0xa5	// 0	Display all pixels white, greyscale=15
-#define LCD_MODEBLACK	0xa6	// 0	Display all pixels black, greyscale=0
-#define LCD_MODEINVERS	0xa7	// 0	Display all pixels inverted, greyscale=15-val
-#define LCD_MUXRATIO	0xa8	// 1	Set ratio to X+1, X>14, (0x7f)
-#define LCD_FASELECT	0xab	// 0	Select internal Vdd regulator when 1, external when 0 (0x01)
-
-#define LCD_INACTIVE	0xae	// 0	Switches display to sleep mode
-#define LCD_ACTIVE		0xaf	// 0	Switches display on, normal mode
-
-#define LCD_PHASELEN	0xb1	// 1	High nibble phase2, low nibbel phase1 (0x74)
-#define LCD_NOP1		0xb2	// 0	No operation
-#define LCD_OSC_D_F		0xb3	// 1	Set oscillator divider (0x00)
-#define LCD_GPIO		0xb5	// 1	(0x02)
-#define LCD_PCPER2		0xb6	// 1	(0x04)
-#define LCD_GS_TABLE	0xb8	// 15	Pulse width for GS levels 1..15, all unequal and value rising
-#define LCD_GS_LINEAR	0xb9	// 0	Sets linear GS table (default)
-#define LCD_NOP2		0xbb	// 0	No operation
-#define LCD_PCLEVEL		0xbc	// 1	(0x05)
-#define LCD_CDLEVEL		0xbe	// 1	(0x05)
-#define LCD_FBSELECT	0xd5	// 1	(0x00)
-#define LCD_CMDLOCK		0xfd	// 1	Lock OLED command interface (0x16) or unlock (0x12)
+/*
+ * Shadow framebuffer, the dirty rectangle is in bytes (column pairs) and rows
+ */
+uint8_t  lcd_fb[LCD_HEIGHT][LCD_FBW];										// Framebuffer
+int      lcd_c0=LCD_FBW, lcd_c1=-1, lcd_r0=LCD_HEIGHT, lcd_r1=-1;			// Dirty rectangle, empty
+int      lcd_dma;															// Claimed DMA channel
+uint32_t lcd_t0;															// Transfer start [usec], see stats.c
+bool     lcd_dark;															// Display off until the first frame is sent
+#define LCD_DRAIN_US	500													// I2C FIFO drain time after DMA completion
 
 
-#define I2C_SSD1327		0x3c												// I2C address (0x3C)
-#define LCD_CTRLCMD		0x00												// Control byte for burst commands
-#define LCD_CTRLDATA	0x40												// Control byte for burst data
-#define LCD_CTRLSINGLE	0x80												// OR in case of single command/data
-#define LCD_CTRLMULTI	0x00												// OR in case of multibyte command/data
+/*
+ * Add pixel area (x, y, w, h) to the dirty rectangle
+ */
+static void lcd_dirty(int x, int y, int w, int h)
+{
+	if ((w<=0) || (h<=0)) return;
+	if (x/2 < lcd_c0) lcd_c0 = x/2;
+	if ((x+w)/2-1 > lcd_c1) lcd_c1 = (x+w)/2-1;
+	if (y < lcd_r0) lcd_r0 = y;
+	if (y+h-1 > lcd_r1) lcd_r1 = y+h-1;
+	sched_post(SCHED_LCD);
+}
 
+/*
+ * Flush completion: DMA_IRQ_1 when the DMA is done, then an alarm when the last bytes have been sent
+ */
+int64_t lcd_alarmcb(alarm_id_t id, void *user_data)
+{
+	sched_post(SCHED_LCD);
+	return 0;
+}
+void lcd_dmairq(void)
+{
+	if (!dma_channel_get_irq1_status(lcd_dma)) return;
+	dma_channel_acknowledge_irq1(lcd_dma);
+	stats_add(STATS_LCD, time_us_32() - lcd_t0);							// Longer than SysTick wraps
+	add_alarm_in_us(LCD_DRAIN_US, lcd_alarmcb, NULL, true);
+}
 
-#define LCD_DELAY		1000												// Screen refresh time
-		
-#define LCD_WIDTH		0x80												// Pixels
-#define LCD_HEIGHT		0x80												// Pixels
+/*
+ * Check for a flush in progress, the I2C bus is free when the DMA is done and the I2C FIFO is empty and idle
+ * After a transfer abort (e.g. display not responding) the remainder of the flush is dropped.
+ */
+bool lcd_busy(void)
+{
+	i2c_hw_t *hw = i2c_get_hw(i2c0);
+	
+	if (hw->raw_intr_stat & I2C_IC_RAW_INTR_STAT_TX_ABRT_BITS)				// Aborted, FIFO flushed
+	{
+		dma_channel_abort(lcd_dma);
+		(void)hw->clr_tx_abrt;												// Read to clear
+	}
+	if (dma_channel_is_busy(lcd_dma)) return true;
+	if (!(hw->status & I2C_IC_STATUS_TFE_BITS)) return true;				// TX FIFO not empty
+	return ((hw->status & I2C_IC_STATUS_ACTIVITY_BITS) != 0);				// Still transferring
+}
 
+/*
+ * Start a DMA transfer of n data_cmd words to I2C target addr, for the display backend
+ */
+void lcd_xfer(uint8_t addr, uint16_t *tx, int n)
+{
+	i2c_hw_t *hw = i2c_get_hw(i2c0);
+	dma_channel_config c;
+	
+	hw->enable = 0;															// Target can only change when disabled
+	hw->tar = addr;
+	hw->enable = 1;
+	c = dma_channel_get_default_config(lcd_dma);
+	channel_config_set_transfer_data_size(&c, DMA_SIZE_16);
+	channel_config_set_read_increment(&c, true);
+	channel_config_set_write_increment(&c, false);
+	channel_config_set_dreq(&c, i2c_get_dreq(i2c0, true));					// Paced by I2C TX FIFO
+	lcd_t0 = time_us_32();
+	dma_channel_configure(lcd_dma, &c, &hw->data_cmd, tx, n, true);
+}
 
-uint8_t txdata[1+LCD_WIDTH];												// Maximum transfer size, one line of data
+/*
+ * Send the dirty rectangle to the display, unless a previous flush is still busy
+ */
+void lcd_flush(void)
+{
+	int r;
 
+	if (lcd_busy()) return;
+	if (lcd_c1 < lcd_c0)													// Nothing to do
+	{
+		if (lcd_dark) lcd_hw_display(true);									// First frame is complete
+		lcd_dark = false;
+		return;
+	}
+	r = lcd_hw_flush(lcd_c0, lcd_c1, lcd_r0, lcd_r1);
+	if (r < lcd_r1)															// Rest after this transfer, see lcd_dmairq()
+	{
+		lcd_r0 = r+1;
+		return;
+	}
+	lcd_c0 = LCD_FBW; lcd_c1 = -1; lcd_r0 = LCD_HEIGHT; lcd_r1 = -1;		// Clean
+}
 
 /*
- * Set display active area (cursor) to (x,y) left upper corner and (width x height) size
+ * Flush until the canvas is clean and the display is on, for use without the scheduler
  */
-void lcd_cursor(uint8_t x, uint8_t y, uint8_t w, uint8_t h)
+void lcd_sync(void)
 {
-	txdata[0] = LCD_CTRLCMD | LCD_CTRLMULTI;								// Multiple command byte
-	txdata[1] = LCD_WINCOLADDR;												// Set window columns
-	txdata[2] = (x/2)&0x3f;													// left 
-	txdata[3] = (((x+w)/2)-1)&0x3f;											// right 
-	txdata[4] = LCD_WINROWADDR;												// Set window rows
-	txdata[5] = (y)&0x7f;													// top
-	txdata[6] = (y+h-1)&0x7f;												// bottom
-	i2c_write_blocking(i2c0, I2C_SSD1327, txdata, 7, false);				// Send commands
+	while ((lcd_c1 >= lcd_c0) || lcd_dark || lcd_busy())
+		lcd_flush();
 }
 
 /*
@@ -136,13 +176,10 @@ void lcd_clrscr(uint8_t x, uint8_t y, uint8_t w, uint8_t h)
 {
 	int i;
 	
-	lcd_cursor(x,y,w,h);													// Set window
-	
-	txdata[0] = LCD_CTRLDATA | LCD_CTRLMULTI;
-	memset(&txdata[1], 0x00, w/2);											// Black line
-	
+	if (((x+w)>LCD_WIDTH)||((y+h)>LCD_HEIGHT)) return;						// Out of range!
 	for (i=0; i<h; i++)
-		i2c_write_blocking(i2c0, I2C_SSD1327, txdata, 1+w/2, false);		// Clear one line
+		memset(&lcd_fb[y+i][x/2], 0x00, w/2);								// Black line
+	lcd_dirty(x, y, w, h);
 }
 
 
@@ -152,7 +189,7 @@ void lcd_clrscr(uint8_t x, uint8_t y, uint8_t w, uint8_t h)
  */
 void lcd_putc(uint8_t x, uint8_t y, uint8_t c, uint8_t *font, bool invert)
 {
-	int i, w, h;
+	int i, j, w, h;
 	uint8_t xorbyte;														// XOR value for memcpy
 	uint8_t *srce, *dest;													// Pointers for memcpy
 	
@@ -163,17 +200,16 @@ void lcd_putc(uint8_t x, uint8_t y, uint8_t c, uint8_t *font, bool invert)
 
 	w=font[0]; h=font[1];													// Retrieve character width and height
 	if (((x+w)>LCD_WIDTH)||((y+h)>LCD_HEIGHT)) return;						// Out of range!
-	lcd_cursor(x,y,w,h);													// Define window
-	
-	txdata[0] = LCD_CTRLDATA | LCD_CTRLMULTI ;								// Multiple data byte
 
 	xorbyte = (invert?0xff:0x00);											// Optionally set inversion
-	srce = &font[4 + (int)c*w*h/2];											// Initialize pointers
-	dest = &txdata[1];
-	for (i=0; i<w*h/2; i++)													// Copy data
-		*dest++ = *srce++ ^ xorbyte;
-
-	i2c_write_blocking(i2c0, I2C_SSD1327, txdata, 1+w*h/2, false);			// Send character 
+	srce = &font[4 + (int)c*w*h/2];											// Initialize pointer
+	for (i=0; i<h; i++)														// Copy data
+	{
+		dest = &lcd_fb[y+i][x/2];
+		for (j=0; j<w/2; j++)
+			*dest++ = *srce++ ^ xorbyte;
+	}
+	lcd_dirty(x, y, w, h);
 }
 
 /*
@@ -195,36 +231,18 @@ void lcd_puts(uint8_t x, uint8_t y, char *buf, uint8_t *font, bool invert)
  */
 void lcd_putg(uint8_t x, uint8_t y, uint8_t *bitmap, bool invert)
 {
-	int w, h, i, j;
-	uint8_t xorbyte = 0x00;													// XOR value for memcpy
-	uint8_t *srce, *dest;													// Pointers for memcpy
-	
-	w=bitmap[0]; h=bitmap[1];												// Retrieve bitmap width and height
-	if (((x+w)>LCD_WIDTH)||((y+h)>LCD_HEIGHT)) return;						// Out of range!
-	lcd_cursor(x,y,w,h);													// Define window for writing
-	
-	if (invert) xorbyte = 0xff;												// Optionally set inversion
-	txdata[0] = LCD_CTRLDATA | LCD_CTRLMULTI ;								// Multiple data byte
-	for (i=0; i<h; i++)														// Split up graphic into lines
-	{
-		srce = &bitmap[4 + i*w/2];											// Initialize pointers
-		dest = &txdata[1];
-		for (j=0; j<w/2; j++)												// Copy data
-			*dest++ = *srce++ ^ xorbyte;
-		i2c_write_blocking(i2c0, I2C_SSD1327, txdata, 1+w/2, false);		// Send graphic line 
-	}
+	lcd_putc(x, y, bitmap[2], bitmap, invert);
 }
 
 /*
- * Write a horizontal line on row y
+ * Write a horizontal line on row y and y+1
  */
 void lcd_hruler(uint8_t x, uint8_t y, uint8_t w)
 {
-	lcd_cursor(x,y,w,2);													// Just the line
-	// range x, y and truncate w
-	txdata[0] = LCD_CTRLDATA | LCD_CTRLMULTI;
-	memset(&txdata[1], 0x88, w);											// White line		
-	i2c_write_blocking(i2c0, I2C_SSD1327, txdata, 1+w, false);				// Dump two lines
+	if (((x+w)>LCD_WIDTH)||((y+2)>LCD_HEIGHT)) return;						// Out of range!
+	memset(&lcd_fb[y][x/2], 0x88, w/2);										// White line
+	memset(&lcd_fb[y+1][x/2], 0x88, w/2);
+	lcd_dirty(x, y, w, 2);
 }
 
 /*
@@ -232,44 +250,33 @@ void lcd_hruler(uint8_t x, uint8_t y, uint8_t w)
  */
 void lcd_vruler(uint8_t x, uint8_t y, uint8_t h)
 {
-	lcd_cursor(x,y,2,h);													// Just the line
-	// range x, y and truncate w
-	txdata[0] = LCD_CTRLDATA | LCD_CTRLMULTI;
-	memset(&txdata[1], 0x88, h);											// White line		
-	i2c_write_blocking(i2c0, I2C_SSD1327, txdata, 1+h, false);				// Dump two lines
+	int i;
+	
+	if (((x+2)>LCD_WIDTH)||((y+h)>LCD_HEIGHT)) return;						// Out of range!
+	for (i=0; i<h; i++)
+		lcd_fb[y+i][x/2] = 0x88;											// White line
+	lcd_dirty(x, y, 2, h);
 }
 
 
 /*
- * Initialize and clear display
+ * Initialize and clear display, and draw the splash logo unless LCD_SPLASH is 0
+ * The frame is sent by the next lcd_flush(), this does not wait for it.
  */
 void lcd_init()
 {
-	int page;
+	lcd_dma = dma_claim_unused_channel(true);
+	irq_set_exclusive_handler(DMA_IRQ_1, lcd_dmairq);
+	dma_channel_set_irq1_enabled(lcd_dma, true);
+	irq_set_enabled(DMA_IRQ_1, true);
+	i2c_get_hw(i2c0)->dma_cr = I2C_IC_DMA_CR_TDMAE_BITS;					// TX DMA handshake
 	
 	sleep_ms(1);
-
-	txdata[0] = LCD_CTRLCMD | LCD_CTRLMULTI ;								// Multiple command byte
-	txdata[1] = LCD_CMDLOCK;												// Unlock command interface
-	txdata[2] = 0x12;
-	txdata[3] = LCD_CTRLCMD | LCD_CTRLMULTI ;								// Multiple command byte
-	txdata[4] = LCD_REMAP;													// Display upside-down
-	txdata[5] = 0x53;														// So change GDRAM mapping
-	txdata[6] = LCD_CTRLCMD | LCD_CTRLSINGLE ;								// Multiple command byte	
-	txdata[7] = LCD_ACTIVE;													// DISPLAY ON
-	txdata[8] = LCD_CTRLCMD | LCD_CTRLSINGLE ;								// Multiple command byte	
-	txdata[9] = LCD_MODENORM;												// NORMAL MODE
-	i2c_write_blocking(i2c0, I2C_SSD1327, txdata, 10, false);
-	
-	// Output init flush screen
-	txdata[0] = LCD_CTRLCMD | LCD_CTRLSINGLE;
-	txdata[1] = LCD_INACTIVE;
-	i2c_write_blocking(i2c0, I2C_SSD1327, txdata, 2, false);				// Send commands
+	lcd_hw_init();															// Display is off
+	lcd_dark = true;
 
 	lcd_clrscr(0,0,128,128);
-	lcd_putg(0, 0, LCD_UDJAT128, true);
-	
-	txdata[0] = LCD_CTRLCMD | LCD_CTRLSINGLE;
-	txdata[1] = LCD_ACTIVE;
-	i2c_write_blocking(i2c0, I2C_SSD1327, txdata, 2, false);				// Send commands
+	if (LCD_SPLASH)
+		lcd_putg(0, 0, LCD_UDJAT128, true);
+	sched_post(SCHED_LCD);													// Complete frame
 }
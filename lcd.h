@@ -36,6 +36,16 @@ extern uint8_t 			PUL24x12[];
 extern uint8_t 			UDJAT128x128[];
 extern uint8_t			CIRCLE16x16[];
 
+#ifndef LCD_SPLASH
+#define LCD_SPLASH		1													// Logo at power up until the first key, see CMakeLists.txt
+#endif
+
+/* Canvas, nibble per pixel */
+#define LCD_WIDTH		0x80												// Pixels
+#define LCD_HEIGHT		0x80												// Pixels
+#define LCD_FBW			(LCD_WIDTH/2)										// Bytes per row
+extern uint8_t			lcd_fb[LCD_HEIGHT][LCD_FBW];
+
 /* API */
 void lcd_putc(uint8_t x, uint8_t y, uint8_t c, uint8_t *font, bool invert);
 void lcd_puts(uint8_t x, uint8_t y, char *buf, uint8_t *font, bool invert);
@@ -44,5 +54,14 @@ void lcd_hruler(uint8_t x, uint8_t y, uint8_t w);
 void lcd_vruler(uint8_t x, uint8_t y, uint8_t h);
 void lcd_clrscr(uint8_t x, uint8_t y, uint8_t w, uint8_t h);
 void lcd_init(void);
+void lcd_flush(void);														// Send changes, once per loop tick
+bool lcd_busy(void);														// Flush in progress, I2C in use
+void lcd_sync(void);														// Flush and wait, without the scheduler
+
+/* Display backend, either lcd-SSD1327.c or lcd-SH1106.c is linked */
+void lcd_hw_init(void);														// Initialize, display off
+void lcd_hw_display(bool on);
+int  lcd_hw_flush(int c0, int c1, int r0, int r1);							// Send canvas bytes c0..c1, from row r0, returns last row sent
+void lcd_xfer(uint8_t addr, uint16_t *tx, int n);							// DMA n data_cmd words to I2C addr
 
 #endif
\ No newline at end of file
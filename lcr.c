@@ -0,0 +1,216 @@
+/*
+ * lcr.c
+ *
+ * Created: Jan 2022
+ * Author: Arjan te Marvelde
+ *
+ * The LCR meter.
+ *
+ * A sine stimulus is played on channel A, which drives the device under test (DUT) through a reference resistor:
+ *   GEN A --+-- LCR_RREF --+-- DUT -- GND
+ *           |              |
+ *         ADC0           ADC1
+ * The ADC runs free in round-robin mode on inputs 0 and 1, at 500kS/s, so each input is sampled at LCR_FS.
+ * A DMA channel moves the samples from the ADC FIFO into a ring of LCR_NSAMP pairs, without any CPU involvement.
+ * The transfer count is twice the ring, the first pass gives the DUT time to settle and is overwritten by the second.
+ * So the buffer holds samples LCR_NSAMP..2*LCR_NSAMP-1 of each input, in order.
+ *
+ * The stimulus frequency is rounded to a whole nr of periods in the block, i.e. a DFT bin, so there is no leakage.
+ * The phasor of each input is obtained with a fixed point Goertzel filter on that bin, the DC offset of the stimulus
+ * falls in bin 0 and is rejected. ADC1 is sampled 2usec after ADC0, this is corrected in the phasor of ADC1.
+ * The current through the DUT is (Vs - Vx)/Rref, so Z = Rref * Vx / (Vs - Vx).
+ *
+ * The stimulus is rewound with gen_arm() before the capture, and then the statemachine and the ADC are started
+ * right after each other with interrupts disabled. A block then spans an exact nr of stimulus periods from a known
+ * start, so also the absolute phase of each input is deterministic, apart from the ADC clock granularity (48MHz).
+ * The stimulus keeps on playing after the measurement, channel A is taken over until it is redefined.
+ */
+
+#include <stdio.h>
+#include <math.h>
+#include "pico/stdlib.h"
+#include "hardware/sync.h"
+#include "hardware/adc.h"
+#include "hardware/dma.h"
+
+#include "gen.h"
+#include "hmi.h"
+#include "core1.h"
+#include "sched.h"
+#include "lcr.h"
+
+#define LCR_PINVS		26													// ADC0, generator side of Rref
+#define LCR_PINVX		27													// ADC1, DUT side of Rref
+#define LCR_VLSB		(3.3/4096)											// ADC LSB [V]
+#define LCR_ZERO		2048												// ADC mid scale
+#define LCR_SKEW		2.0e-6												// ADC1 delay after ADC0 [s]
+#define LCR_RINGBITS	12													// log2 of buffer size in bytes
+#define LCR_Q			29													// Goertzel coefficient fraction bits
+
+uint16_t lcr_buf[2*LCR_NSAMP] __attribute__((aligned(4*LCR_NSAMP)));		// Aligned for RING_SIZE
+int      lcr_dma;															// Capture DMA channel
+double   lcr_freq;															// Active stimulus frequency
+uint32_t lcr_ev;															// Events to post when done
+bool     lcr_busy;															// Capture in progress
+
+/*
+ * Alarm at the end of a capture, the result is obtained from the scheduled task
+ */
+static int64_t lcr_alarmcb(alarm_id_t id, void *user_data)
+{
+	sched_post(lcr_ev);
+	return 0;																// No reschedule
+}
+
+/*
+ * Goertzel filter on bin m of the LCR_NSAMP samples at buf[0], buf[2], ...
+ * The state is in integers, the coefficient 2cos(w) in LCR_Q fraction bits, which does not overflow int64.
+ * The resulting phasor is the DFT value X[m], scaled to Volt amplitude.
+ */
+static void lcr_goertzel(uint16_t *buf, uint32_t m, float *re, float *im)
+{
+	double w = 2*M_PI*m/LCR_NSAMP;
+	int64_t coef = (int64_t)llround(2*cos(w)*(double)(1LL<<LCR_Q));
+	int32_t s0, s1 = 0, s2 = 0;
+	uint32_t i;
+
+	for (i=0; i<LCR_NSAMP; i++)
+	{
+		s0 = ((int32_t)buf[2*i] - LCR_ZERO) + (int32_t)((coef*s1) >> LCR_Q) - s2;
+		s2 = s1;
+		s1 = s0;
+	}
+	*re = (float)((s1*cos(w) - s2) * 2*LCR_VLSB/LCR_NSAMP);				// X[m] = s1*exp(jw) - s2
+	*im = (float)((s1*sin(w)) * 2*LCR_VLSB/LCR_NSAMP);
+}
+
+/*
+ * Start a measurement near freq, the stimulus frequency is rounded to a bin
+ */
+double lcr_start(double freq, uint32_t ev)
+{
+	c1cmd_t cmd;
+	uint32_t m, save;
+
+	if (lcr_busy) return 0.0;
+	m = (uint32_t)(freq*LCR_NSAMP/LCR_FS + 0.5);							// Nearest bin
+	if (m < 1) m = 1;
+	if (m > LCR_NSAMP/2-1) m = LCR_NSAMP/2-1;
+	lcr_freq = m*LCR_FS/LCR_NSAMP;
+	lcr_ev = ev;
+
+	/* Stimulus on channel A, stopped at its first sample */
+	cmd.cmd = CORE1_DEF;
+	cmd.ch = OUTA;
+	cmd.def.mode = HMI_SIN;
+	cmd.def.time = (float)(1.0/lcr_freq);
+	cmd.def.duty = 50; cmd.def.rise = 0; cmd.def.fall = 0;
+	core1_post(&cmd);
+	cmd.cmd = CORE1_ARM;
+	core1_post(&cmd);
+	core1_sync();
+
+	/* Arm the capture, the DMA waits for the ADC */
+	adc_run(false);
+	adc_fifo_drain();
+	adc_select_input(0);													// Round robin starts at ADC0
+	dma_channel_set_write_addr(lcr_dma, lcr_buf, false);
+	dma_channel_set_trans_count(lcr_dma, 2*2*LCR_NSAMP, true);				// Settle pass and measurement pass
+
+	/* Go */
+	save = save_and_disable_interrupts();
+	gen_enable(OUTA, true);
+	adc_run(true);
+	restore_interrupts(save);
+	lcr_busy = true;
+	add_alarm_in_us((uint64_t)(2*LCR_NSAMP*1.0e6/LCR_FS) + 1000, lcr_alarmcb, NULL, true);
+	return lcr_freq;
+}
+
+/*
+ * Evaluate a completed capture
+ */
+bool lcr_result(lcr_t *res)
+{
+	float sr, si, xr, xi, dr, di, d, cr, ci;
+	double w;
+	uint32_t m;
+
+	if (!lcr_busy || dma_channel_is_busy(lcr_dma)) return false;
+	adc_run(false);
+	adc_fifo_drain();
+	lcr_busy = false;
+
+	m = (uint32_t)(lcr_freq*LCR_NSAMP/LCR_FS + 0.5);
+	w = 2*M_PI*lcr_freq;
+	lcr_goertzel(&lcr_buf[0], m, &sr, &si);									// Vs
+	lcr_goertzel(&lcr_buf[1], m, &xr, &xi);									// Vx
+	cr = (float)cos(w*LCR_SKEW); ci = (float)-sin(w*LCR_SKEW);				// Correct Vx for the ADC1 delay
+	d = xr*cr - xi*ci; xi = xr*ci + xi*cr; xr = d;
+
+	res->freq = lcr_freq;
+	res->vs = sqrtf(sr*sr + si*si);
+	res->vx = sqrtf(xr*xr + xi*xi);
+	res->phase = (float)((atan2(xi, xr) - atan2(si, sr)) * 180.0/M_PI);
+	if (res->phase > 180.0) res->phase -= 360.0;
+	if (res->phase < -180.0) res->phase += 360.0;
+
+	dr = sr - xr; di = si - xi;												// Vs - Vx, i.e. I*Rref
+	d = dr*dr + di*di;
+	if (d == 0.0)															// No current: open
+	{
+		res->r = INFINITY; res->x = 0.0; res->l = 0.0; res->c = 0.0;
+		return true;
+	}
+	res->r = (float)(LCR_RREF * (xr*dr + xi*di) / d);						// Rref * Vx / (Vs - Vx)
+	res->x = (float)(LCR_RREF * (xi*dr - xr*di) / d);
+	res->l = (res->x > 0.0) ? (float)(res->x / w) : 0.0;
+	res->c = (res->x < 0.0) ? (float)(-1.0 / (w * res->x)) : 0.0;
+	return true;
+}
+
+/*
+ * Average of n conversions of ADC0, a DC level on the generator side of Rref, in [V]; -1.0 while a capture is busy
+ * Single conversions without the FIFO, the capture set-up is restored afterwards. Used for calibration, see cal.c.
+ */
+float lcr_dc(uint32_t n)
+{
+	uint32_t sum = 0, i;
+
+	if (lcr_busy || (n == 0)) return -1.0;
+	adc_run(false);
+	adc_fifo_setup(false, false, 1, false, false);
+	adc_set_round_robin(0);
+	adc_select_input(0);
+	for (i=0; i<n; i++)
+		sum += adc_read();
+	adc_set_round_robin(0x03);												// As in lcr_init()
+	adc_fifo_setup(true, true, 1, false, false);
+	adc_fifo_drain();
+	return (float)sum * LCR_VLSB / n;
+}
+
+/*
+ * Initialize the ADC for free running round robin conversions into the FIFO, and claim the capture DMA channel
+ */
+void lcr_init(void)
+{
+	dma_channel_config c;
+
+	adc_init();
+	adc_gpio_init(LCR_PINVS);
+	adc_gpio_init(LCR_PINVX);
+	adc_set_round_robin(0x03);												// ADC0 and ADC1
+	adc_fifo_setup(true, true, 1, false, false);							// DREQ on each sample, 12 bit
+	adc_set_clkdiv(0);														// Back to back, 96 ADC clocks
+
+	lcr_dma = dma_claim_unused_channel(true);
+	c = dma_channel_get_default_config(lcr_dma);
+	channel_config_set_transfer_data_size(&c, DMA_SIZE_16);
+	channel_config_set_read_increment(&c, false);							// From ADC FIFO
+	channel_config_set_write_increment(&c, true);							//  into buffer
+	channel_config_set_ring(&c, true, LCR_RINGBITS);						//  wrapping around
+	channel_config_set_dreq(&c, DREQ_ADC);
+	dma_channel_configure(lcr_dma, &c, lcr_buf, &adc_hw->fifo, 0, false);
+	lcr_busy = false;
+}
@@ -0,0 +1,42 @@
+#ifndef __LCR_H__
+#define __LCR_H__
+/*
+ * lcr.h
+ *
+ * Created: Jan 2022
+ * Author: Arjan te Marvelde
+ *
+ * See lcr.c for more information
+ */
+
+#define LCR_NSAMP		1024												// Sample pairs in a block, power of 2
+#define LCR_FS			250000.0											// Sample rate per ADC input [Hz]
+#define LCR_RREF		1000.0												// Reference resistor [Ohm]
+
+/*
+ * The result of a measurement
+ * The impedance of the device under test is Z = r + j*x, at frequency freq.
+ * Depending on the sign of x, either l or c is valid and the other is 0.
+ */
+typedef struct
+{
+	double	freq;															// Stimulus frequency [Hz]
+	float	vs, vx;															// Amplitude at generator and DUT [V]
+	float	phase;															// Phase of vx relative to vs [deg]
+	float	r, x;															// Impedance [Ohm]
+	float	l, c;															// Inductance [H] or capacitance [F]
+} lcr_t;
+
+/* Claim the ADC and its DMA channel, call after core1_init() */
+void lcr_init(void);
+
+/* Start a measurement near freq [Hz], posts sched events ev when done; returns actual frequency, 0 when busy */
+double lcr_start(double freq, uint32_t ev);
+
+/* Returns true once for each completed measurement, with the result in res */
+bool lcr_result(lcr_t *res);
+
+/* Average DC level [V] on ADC0 over n conversions, -1.0 when busy */
+float lcr_dc(uint32_t n);
+
+#endif
@@ -0,0 +1,192 @@
+/*
+ * mod.c
+ *
+ * Created: Jan 2022
+ * Author: Arjan te Marvelde
+ *
+ * Modulation of a channel waveform.
+ *
+ * The carrier is synthesized once into the second half of the inactive channel buffer, see mod_buf(), and is played
+ * in loop mode as usual. It is at most half a buffer long, so the first half of each buffer is free for the updates.
+ * Core 1 then updates the channel on every buffer pass, using the double buffering of gen_play(): as soon as the
+ * DMA has left the inactive buffer (gen_loadfree()), the next buffer is prepared in place and swapped in at the
+ * next period boundary, so there are no glitches. The pass duration in ring mode is set to one buffer, so the update
+ * rate is the buffer rate, e.g. more than 60kHz for a 2048 sample carrier at 125MHz.
+ *
+ * The modulating tone is a 32 bit phase accumulator, advanced with the elapsed time on each update, so the
+ * modulating frequency does not depend on how many passes core 1 could keep up with.
+ * - AM scales the carrier around the midlevel into the inactive buffer, with the word parallel synth_scale():
+ *   gain (1 + m*sin)/(1 + m), so the peaks are at full scale.
+ * - FM leaves the samples alone and changes the PIO divider, through the buffer duration passed to gen_play():
+ *   f = fc + dev*sin. The divider is taken over at the period boundary, like any gen_play() swap.
+ *   Once both channel buffers hold the corrected carrier, the updates go through gen_playdac(), so the DAC
+ *   correction table is not applied again on every pass.
+ * - PM is done as FM with the derivative of the modulating signal: f = fc + beta*fm*cos.
+ * The carrier is byte samples, so modulation is only available in 8 bit output mode.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+
+#include "gen.h"
+#include "synth.h"
+#include "mod.h"
+
+#define MOD_AMCYC		6													// Estimated core 1 cycles per sample of an AM update
+
+typedef struct
+{
+	bool		active;														// Modulation running on channel
+	int			mode;														// MOD_AM, MOD_FM or MOD_PM
+	wfg_t		carrier;													// Carrier waveform, see mod_buf()
+	uint32_t	phase;														// Modulating phase accumulator
+	uint32_t	inc;														// Phase increment per usec
+	uint32_t	t;															// Time of last update [usec]
+	int32_t		depth;														// AM index in Q15
+	uint32_t	norm;														// AM gain normalization, 256/(1+m) in Q8
+	float		rel;														// FM deviation relative to fc
+	uint32_t	fill;														// Nr of channel buffers holding the corrected carrier
+} mod_t;
+mod_t mod_ch[GEN_NCH];
+
+
+
+/*
+ * Buffer of channel ch for the carrier samples, core 1 synthesizes the carrier into it before mod_start()
+ * This is the second half of the inactive channel buffer, for a carrier of at most gen_maxlen()/2 samples: the
+ * buffers only play their first half while modulating, so it stays in place until the channel is taken over.
+ * Returns NULL when the channel is not available.
+ */
+uint8_t *mod_buf(int ch)
+{
+	uint8_t *buf = gen_loadbuf(ch);
+
+	return (buf == NULL) ? NULL : buf + gen_maxlen()/2;
+}
+
+/*
+ * Start modulating carrier wf on channel ch, wf has one or more periods of fc [Hz] in mod_buf()
+ * The depth is clipped to 1 for AM, and the FM or PM deviation to MOD_MAXREL of fc. FM raises the frequency by
+ * lowering the PIO divider, so the deviation is also clipped to what the carrier divider leaves above 1, see
+ * core1_genmod(), and a deviation of less than one 1/256 divider step is rejected.
+ * The modulation is updated once per buffer pass at most, and an AM pass costs about MOD_AMCYC cycles per sample,
+ * so fm must be below half of that update rate; MOD_MAXFM covers the cost of an FM update.
+ * The unmodulated carrier plays first, mod_evaluate() takes over from the next buffer pass.
+ * Returns false in 16 bit mode, or when fm or depth is out of range.
+ */
+bool mod_start(int ch, wfg_t *wf, double fc, int mode, double fm, float depth)
+{
+	mod_t *m;
+	float rel, div;
+	double rate;
+
+	ch = (uint)ch%GEN_NCH;
+	m = &mod_ch[ch];
+	if (gen_getwidth() != GEN_WIDTH8) return false;							// Byte samples only
+	if ((wf->len == 0) || (wf->dur <= 0.0)) return false;
+	rate = 1.0 / wf->dur;													// Buffer passes per second
+	if ((mode == MOD_AM) && (rate > _fsys / (MOD_AMCYC * wf->len)))			// Core 1 can not keep up
+		rate = _fsys / (MOD_AMCYC * wf->len);
+	if ((fm <= 0.0) || (fm > MOD_MAXFM) || (fm > rate/2) || (depth < 0.0)) return false;
+	m->mode = mode;
+	m->carrier = *wf;
+	m->phase = 0;
+	m->inc = (uint32_t)(fm * 4294967296.0 / 1.0e6 + 0.5);					// inc = fm * 2^32 per usec
+	m->depth = 0; m->rel = 0.0;
+	if (mode == MOD_AM)
+	{
+		if (depth > 1.0) depth = 1.0;
+		m->depth = (int32_t)(depth * 32768.0f);
+	}
+	else
+	{
+		rel = (mode == MOD_PM) ? (float)(depth * fm / fc) : (float)(depth / fc);	// Peak deviation relative to fc
+		div = (float)(_fsys * wf->dur / wf->len);							// Carrier PIO divider
+		if (rel > MOD_MAXREL) rel = MOD_MAXREL;
+		if (rel > div - 1.0f) rel = div - 1.0f;								// Divider 1 at the peak
+		if ((rel > 0.0f) && (rel*div < 1.0f/256)) return false;				// Less than one divider step
+		m->rel = rel;
+	}
+	m->norm = 0x80000000u / (32768u + (uint32_t)m->depth);					// 256/(1+m) in Q8
+	gen_passtime(ch, 0);													// One buffer per pass
+	gen_play(ch, &m->carrier);												// Unmodulated first pass
+	m->fill = 1;
+	m->t = time_us_32();
+	m->active = true;
+	return true;
+}
+
+/*
+ * Stop modulating channel ch, the last updated buffer keeps on playing
+ * The ring mode pass duration is set back to the default, for the next gen_play().
+ */
+void mod_stop(int ch)
+{
+	ch = (uint)ch%GEN_NCH;
+	if (!mod_ch[ch].active) return;
+	mod_ch[ch].active = false;
+	gen_passtime(ch, GEN_RINGUS);
+}
+
+/*
+ * True when any channel is modulated, so the core 1 loop must keep calling mod_evaluate()
+ */
+bool mod_active(void)
+{
+	int ch;
+
+	for (ch=0; ch<GEN_NCH; ch++)
+		if (mod_ch[ch].active) return true;
+	return false;
+}
+
+/*
+ * Update each modulated channel of which the inactive buffer is free, called from the core 1 loop
+ * The modulating phase is advanced with the elapsed time, then the next buffer is prepared in place and swapped in
+ * by gen_play() at the next period boundary. A channel that has not taken over its last update is skipped.
+ * AM writes uncorrected samples on each pass, FM and PM reuse the corrected carrier, see the header.
+ */
+void mod_evaluate(void)
+{
+	mod_t *m;
+	wfg_t wf;
+	uint32_t now, g;
+	int32_t s;
+	int ch;
+	bool dac;
+
+	for (ch=0; ch<GEN_NCH; ch++)
+	{
+		m = &mod_ch[ch];
+		if (!m->active || !gen_loadfree(ch)) continue;						// Previous update still pending
+		now = time_us_32();
+		m->phase += m->inc * (now - m->t);									// Wraps modulo a period
+		m->t = now;
+		wf = m->carrier;
+		wf.buf = gen_loadbuf(ch);
+		dac = false;
+		if (m->mode == MOD_AM)
+		{
+			s = (m->depth * synth_sin(m->phase)) >> 15;						// m*sin in Q15
+			g = ((uint32_t)(32768 + s) * m->norm) >> 23;					// 256*(1+m*sin)/(1+m), fits 32 bits
+			synth_scale(wf.buf, m->carrier.buf, wf.len, g);
+		}
+		else
+		{
+			if (m->fill < 2)												// Carrier into both buffers once
+			{
+				memcpy(wf.buf, m->carrier.buf, wf.len);
+				m->fill++;
+			}
+			else
+				dac = true;													// Corrected on an earlier pass
+			s = synth_sin((m->mode == MOD_PM) ? (m->phase + 0x40000000) : m->phase);	// cos for PM
+			wf.dur = m->carrier.dur / (1.0f + m->rel * (float)s * (1.0f/32768.0f));
+		}
+		if (dac)
+			gen_playdac(ch, &wf);											// In place, swapped at period boundary
+		else
+			gen_play(ch, &wf);
+	}
+}
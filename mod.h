@@ -0,0 +1,36 @@
+#ifndef __MOD_H__
+#define __MOD_H__
+/*
+ * mod.h
+ *
+ * Created: Jan 2022
+ * Author: Arjan te Marvelde
+ *
+ * See mod.c for more information
+ */
+
+#include "gen.h"
+
+#define MOD_AM			0													// Amplitude modulation, depth is index [0..1]
+#define MOD_FM			1													// Frequency modulation, depth is peak deviation [Hz]
+#define MOD_PM			2													// Phase modulation, depth is peak deviation [rad]
+
+#define MOD_MAXFM		30000.0												// Maximum modulating frequency [Hz], see mod_start()
+#define MOD_MAXREL		0.9f												// Maximum FM deviation relative to fc
+
+/* Buffer for the carrier of channel ch, holds gen_maxlen()/2 samples */
+uint8_t *mod_buf(int ch);
+
+/* Start modulation on channel ch of carrier wf at frequency fc [Hz], with mode, modulating frequency fm [Hz] and depth */
+bool mod_start(int ch, wfg_t *wf, double fc, int mode, double fm, float depth);
+
+/* Stop modulation on channel ch, the last buffer keeps on playing until the output is taken over */
+void mod_stop(int ch);
+
+/* True when modulation is running on any channel */
+bool mod_active(void);
+
+/* Update the free buffers of the modulated channels, to be called from the core 1 loop */
+void mod_evaluate(void);
+
+#endif
@@ -13,10 +13,21 @@
 #include <stdlib.h>
 #include <string.h>
 #include "pico/stdlib.h"
-#include "hardware/pll.h"
+#include "hardware/dma.h"
+#include "hardware/i2c.h"
 
 #include "uWFG.h"
 #include "gen.h"
+#include "core1.h"
+#include "plan.h"
+#include "lcr.h"
+#include "dds.h"
+#include "mod.h"
+#include "stats.h"
+#include "preset.h"
+#include "cal.h"
+#include "lcd.h"
+#include "sched.h"
 #include "monitor.h"
 
 
@@ -42,9 +53,12 @@ typedef struct
 
 
 
+int mon_dma;											// DMA channel for CRC calculation
+
 /*** Initialisation, called at startup ***/
 void mon_init()
 {
+	mon_dma = dma_claim_unused_channel(true);		// Sniffer channel
     stdio_init_all();								// Initialize Standard IO
 	printf("\n");
 	printf("=============\n");
@@ -60,7 +74,31 @@ void mon_init()
 /*** Below the definitions of the shell commands, add where needed ***/
 /*** ------------------------------------------------------------- ***/
 
-wfg_t mon_wave;
+char *mon_mode[HMI_NMODE] = {"sqr", "tri", "saw", "sin", "pul"};			// Same order as HMI_SQR..HMI_PUL
+
+/*
+ * Channel argument i, A or B
+ */
+int mon_getch(int i)
+{
+	return (((nargs>i)&&((argv[i][0]=='b')||(argv[i][0]=='B')))?OUTB:OUTA);
+}
+
+/*
+ * Print a machine parseable line with the actual state of channel ch, after core 1 has caught up
+ * Format: <A|B> mode=<m> time=<s> duty=<%> rise=<%> fall=<%> div=<d> fs=<Hz> f=<Hz> ppm=<err>
+ * The f and ppm fields are from the last frequency plan of the channel.
+ */
+void mon_chline(int ch)
+{
+	ch_t *def;
+
+	core1_sync();
+	def = &core1_def[ch];
+	printf("%c mode=%s time=%.6e duty=%d rise=%d fall=%d div=%.4f fs=%.0f f=%.6f ppm=%.3f\n", 'A'+ch, 
+		   mon_mode[def->mode], def->time, def->duty, def->rise, def->fall, gen_getdiv(ch), gen_getrate(ch),
+		   core1_plan[ch].freq, core1_plan[ch].ppm);
+}
 
 
 /*
@@ -68,20 +106,658 @@ wfg_t mon_wave;
  */
 void mon_fsys(void)
 {
-	float f = 1.2e7;														// Assume 12MHz XOSC
-	f *= pll_sys_hw->fbdiv_int&0xfff;										// Feedback divider
-	f /= (pll_sys_hw->prim&0x00070000)>>16;									// Primary divider 1
-	f /= (pll_sys_hw->prim&0x00007000)>>12;									// Primary divider 2
-	printf("System clock: %9.0f Hz\n", f);
+	printf("System clock: %9.0f Hz\n", gen_getfsys());
+}
+
+/*
+ * Change the system clock, the output frequencies are kept
+ * Allowed range is 48..266MHz, see gen_clock(), where only VCO/postdivider combinations that exactly match are accepted.
+ * The I2C bus must be idle, since its clock is derived from the system clock.
+ */
+void mon_clock(void)
+{
+	c1cmd_t cmd;
+	uint32_t khz;
+
+	if (nargs<2) { mon_fsys(); return; }
+	khz = (uint32_t)atoi(argv[1]);
+	if ((khz<GEN_MINKHZ) || (khz>GEN_MAXKHZ)) { printf("ERR clock %u..%u kHz\n", GEN_MINKHZ, GEN_MAXKHZ); return; }
+	while (lcd_busy()) tight_loop_contents();								// No display transfer ongoing
+	cmd.cmd = CORE1_CLOCK;
+	cmd.ch = OUTA;
+	cmd.val = khz;
+	core1_post(&cmd);
+	core1_sync();
+	i2c_set_baudrate(i2c0, 400*1000);										// Peripheral clock changed
+	if ((uint32_t)(_fsys/1000.0 + 0.5) != khz)
+		printf("ERR clock %lu kHz not possible\n", khz);
+	printf("fsys=%.0f\n", _fsys);
+}
+
+/*
+ * Stream binary samples from stdin to a channel, until there is no input for 100 msec
+ * At the end, the output is held at the last sample value.
+ * Stops early when the channel can not stream, or is taken over by another command, e.g. from the HMI.
+ */
+void mon_stream(void)
+{
+	int ch, c, i;
+	uint8_t *blk, last = 0x80;
+	float rate;
+	c1cmd_t cmd;
+
+	if (nargs<3) return;
+	ch = ((argv[1][0]=='b')||(argv[1][0]=='B'))?OUTB:OUTA;					// Channel A or B
+	rate = atof(argv[2]);													// Sample rate in Hz
+	if (rate<=0.0) return;
+	cmd.cmd = CORE1_STREAM;													// Core 1 switches the channel mode
+	cmd.ch = ch;
+	cmd.val = rate;
+	core1_post(&cmd);
+	core1_sync();
+	if (!gen_streaming(ch))
+	{
+		printf("ERR channel %c can not stream\n", 'A'+ch);
+		return;
+	}
+	
+	c = 0;
+	while (c != PICO_ERROR_TIMEOUT)
+	{
+		while ((blk = gen_strblock(ch)) == NULL)
+		{
+			if (!gen_streaming(ch)) break;									// Channel taken over
+			__wfe();														// Sleep until block played
+		}
+		if (blk == NULL) break;
+		for (i=0; i<GEN_STRBLKLEN; i++)
+		{
+			c = getchar_timeout_us(100000L);
+			if (c == PICO_ERROR_TIMEOUT) break;
+			blk[i] = last = (uint8_t)c;
+		}
+		memset(&blk[i], last, GEN_STRBLKLEN-i);								// Pad last block
+		gen_strcommit(ch);
+	}
+	for (i=0; (c == PICO_ERROR_TIMEOUT) && (i<GEN_STRNBLK); i++)			// Flush ring with last value
+	{
+		while (((blk = gen_strblock(ch)) == NULL) && gen_streaming(ch))
+			__wfe();
+		if (blk == NULL) break;
+		memset(blk, last, GEN_STRBLKLEN);
+		gen_strcommit(ch);
+	}
+	printf("Underruns: %lu\n", gen_strunderrun(ch));
+}
+
+/*
+ * Start DDS on a channel, or change its frequency when it is already running the same shape
+ */
+void mon_dds(void)
+{
+	c1cmd_t cmd;
+
+	if (nargs<3) return;
+	cmd.cmd = CORE1_DDS;
+	cmd.ch = ((argv[1][0]=='b')||(argv[1][0]=='B'))?OUTB:OUTA;				// Channel A or B
+	cmd.val = atof(argv[2]);												// Frequency in Hz
+	cmd.def.mode = ((nargs>3)&&(strncmp(argv[3], "saw", 3)==0))?HMI_SAW:HMI_SIN;
+	if ((nargs>3)&&(strncmp(argv[3], "f", 1)==0))							// Only change frequency
+		cmd.cmd = CORE1_FREQ;
+	core1_post(&cmd);
+	printf("DDS %c: %.3f Hz, fs=%.0f Hz\n", 'A'+cmd.ch, cmd.val, _fsys/DDS_DIV);
+}
+
+/*
+ * Restart both channels in sync, with channel B lagging channel A
+ */
+void mon_sync(void)
+{
+	c1cmd_t cmd;
+
+	cmd.cmd = CORE1_SYNC;
+	cmd.ch = OUTA;
+	cmd.val = (nargs>1)?atof(argv[1]):0.0;									// Phase in degrees
+	core1_post(&cmd);
+	printf("Sync: B lags A %.1f deg\n", cmd.val);
+}
+
+/*
+ * Select output width: two 8 bit channels or one 16 bit channel on pins 0..15
+ */
+void mon_width(void)
+{
+	c1cmd_t cmd;
+
+	cmd.cmd = CORE1_WIDTH;
+	cmd.ch = OUTA;
+	cmd.val = ((nargs>1)&&(atoi(argv[1])==16))?GEN_WIDTH16:GEN_WIDTH8;
+	core1_post(&cmd);
+	core1_sync();
+	printf("Width: %d bit\n", 8*gen_getwidth());
+}
+
+/*
+ * Arm a burst of n periods on a channel, triggered by a rising edge on the trigger pin
+ */
+void mon_burst(void)
+{
+	c1cmd_t cmd;
+
+	if (nargs<3) return;
+	cmd.cmd = CORE1_BURST;
+	cmd.ch = ((argv[1][0]=='b')||(argv[1][0]=='B'))?OUTB:OUTA;				// Channel A or B
+	cmd.val = atoi(argv[2]);												// Nr of periods
+	cmd.arg = (nargs>3)?(int)strtol(argv[3], NULL, 0):0x00;					// Idle level
+	if ((cmd.val<1) || (cmd.val>GEN_MAXBURST)) 
+	{
+		printf("Burst: 1..%d periods\n", GEN_MAXBURST);
+		return;
+	}
+	core1_post(&cmd);
+	printf("Burst %c: %.0f periods, idle 0x%02x\n", 'A'+cmd.ch, cmd.val, cmd.arg&0xff);
+}
+
+/*
+ * Software trigger of an armed burst
+ */
+void mon_trig(void)
+{
+	c1cmd_t cmd;
+
+	cmd.cmd = CORE1_TRIG;
+	cmd.ch = ((nargs>1)&&((argv[1][0]=='b')||(argv[1][0]=='B')))?OUTB:OUTA;	// Channel A or B
+	core1_post(&cmd);
+}
+
+/*
+ * Read n binary bytes from stdin into buf, returns the nr of bytes read before a 100 msec timeout
+ */
+uint32_t mon_getbin(uint8_t *buf, uint32_t n)
+{
+	uint32_t i;
+	int c;
+
+	for (i=0; i<n; i++)
+	{
+		c = getchar_timeout_us(100000L);
+		if (c == PICO_ERROR_TIMEOUT) break;
+		if (buf != NULL) buf[i] = (uint8_t)c;
+	}
+	return i;
+}
+
+/*
+ * Calculate the CRC-32 (IEEE 802.3, as zlib) of n bytes in buf, with the DMA sniffer
+ * A dummy memory to memory transfer feeds the bytes to the sniffer.
+ */
+uint32_t mon_crc32(uint8_t *buf, uint32_t n)
+{
+	dma_channel_config c;
+	static uint32_t dummy;
+	uint32_t crc;
+
+	c = dma_channel_get_default_config(mon_dma);
+	channel_config_set_transfer_data_size(&c, DMA_SIZE_8);
+	channel_config_set_read_increment(&c, true);
+	channel_config_set_write_increment(&c, false);
+	channel_config_set_sniff_enable(&c, true);
+	dma_sniffer_enable(mon_dma, 0x1, true);									// CRC-32, bit reversed input
+	dma_sniffer_set_output_reverse_enabled(true);
+	dma_sniffer_set_output_invert_enabled(true);
+	dma_sniffer_set_data_accumulator(0xffffffff);
+	dma_channel_configure(mon_dma, &c, &dummy, buf, n, true);
+	dma_channel_wait_for_finish_blocking(mon_dma);
+	crc = dma_sniffer_get_data_accumulator();								// Read before disabling, for REV and INV
+	dma_sniffer_disable();
+	return crc;
+}
+
+/*
+ * Load a waveform over stdin, straight into the generator buffer of a channel.
+ * Binary format, little endian: uint32 length in bytes, samples, uint32 CRC-32 of the samples.
+ * The waveform duration is given on the command line.
+ */
+void mon_load(void)
+{
+	c1cmd_t cmd;
+	uint8_t hdr[4];
+	uint32_t len, crc;
+
+	if (nargs<3) return;
+	cmd.ch = ((argv[1][0]=='b')||(argv[1][0]=='B'))?OUTB:OUTA;				// Channel A or B
+	cmd.wave.dur = atof(argv[2]);											// Duration of the waveform
+	printf("Ready\n");
+	
+	if (mon_getbin(hdr, 4) < 4) { printf("Load: timeout\n"); return; }
+	len = hdr[0] | (hdr[1]<<8) | (hdr[2]<<16) | (hdr[3]<<24);
+	cmd.cmd = CORE1_TAKE;													// No DDS or modulation writing the buffers
+	core1_post(&cmd);
+	core1_sync();															// Core 1 done with the buffers
+	cmd.cmd = CORE1_WAVE;
+	cmd.wave.buf = gen_alloc(cmd.ch, len) ? gen_loadbuf(cmd.ch) : NULL;		// No intermediate copy
+	if ((len<GEN_MINBUFLEN) || (len>gen_alloclen()) || (len&3) || (cmd.wave.buf == NULL))
+	{
+		while (mon_getbin(NULL, gen_alloclen()) > 0);						// Discard input
+		printf("Load: length %d..%lu, multiple of 4, channel A in 16 bit mode\n", GEN_MINBUFLEN, gen_maxlen());
+		printf("      up to %lu with the other channel of the pair idle or off\n", gen_alloclen());
+		return;
+	}
+	
+	cmd.wave.len = len;
+	if (mon_getbin(cmd.wave.buf, len) < len) { printf("Load: timeout\n"); return; }
+	if (mon_getbin(hdr, 4) < 4) { printf("Load: timeout\n"); return; }
+	crc = hdr[0] | (hdr[1]<<8) | (hdr[2]<<16) | (hdr[3]<<24);
+	if (crc != mon_crc32(cmd.wave.buf, len)) { printf("Load: CRC error\n"); return; }
+	
+	core1_post(&cmd);
+	core1_sync();
+	printf("Load %c: %lu bytes, CRC ok\n", 'A'+cmd.ch, len);
+}
+
+/*
+ * Set one parameter of a channel definition, and play the result
+ * Syntax: <par> <a|b> <value>, where par determines the field of ch_t
+ */
+#define MON_MODE	0
+#define MON_TIME	1
+#define MON_DUTY	2
+#define MON_RISE	3
+#define MON_FALL	4
+void mon_setpar(int par)
+{
+	c1cmd_t cmd;
+	int i, v;
+
+	if (nargs<3) { printf("ERR syntax\n"); return; }
+	cmd.cmd = CORE1_DEF;
+	cmd.ch = mon_getch(1);
+	core1_sync();
+	cmd.def = core1_def[cmd.ch];											// Modify last definition
+	v = atoi(argv[2]);
+	switch (par)
+	{
+	case MON_MODE:
+		for (i=0; i<HMI_NMODE; i++)
+			if (strncmp(argv[2], mon_mode[i], 3)==0) break;
+		if (i>=HMI_NMODE) { printf("ERR mode\n"); return; }
+		cmd.def.mode = i;
+		break;
+	case MON_TIME:
+		cmd.def.time = atof(argv[2]);
+		if (cmd.def.time<=0.0) { printf("ERR time\n"); return; }
+		break;
+	case MON_DUTY:
+		if ((v<0)||(v>100)) { printf("ERR duty\n"); return; }
+		cmd.def.duty = v;
+		break;
+	case MON_RISE:
+		if ((v<0)||(v>100)) { printf("ERR rise\n"); return; }
+		cmd.def.rise = v;
+		break;
+	case MON_FALL:
+		if ((v<0)||(v>100)) { printf("ERR fall\n"); return; }
+		cmd.def.fall = v;
+		break;
+	}
+	core1_post(&cmd);
+	mon_chline(cmd.ch);
+}
+void mon_setmode(void) { mon_setpar(MON_MODE); }
+void mon_settime(void) { mon_setpar(MON_TIME); }
+void mon_setduty(void) { mon_setpar(MON_DUTY); }
+void mon_setrise(void) { mon_setpar(MON_RISE); }
+void mon_setfall(void) { mon_setpar(MON_FALL); }
+
+/*
+ * Query channel state, including actual divider and sample rate
+ */
+void mon_rate(void)
+{
+	mon_chline(mon_getch(1));
+}
+
+/*
+ * Show the frequency plan for a target frequency, without changing the outputs
+ * Optional minimum nr of samples per period and tolerance [ppm].
+ */
+void mon_plan(void)
+{
+	plan_t pl;
+	uint32_t nmin = PLAN_NMIN;
+	float tol = PLAN_TOL;
+	double f;
+
+	if (nargs<2) return;
+	f = atof(argv[1]);
+	if (f<=0.0) return;
+	if (nargs>2) nmin = atoi(argv[2]);
+	if (nargs>3) tol = atof(argv[3]);
+	if (nmin<2) nmin = 2;
+	plan_find(f, nmin, PLAN_MAXPER, tol, &pl);
+	printf("per=%lu k=%lu len=%lu div=%.4f%s f=%.6f ppm=%.3f\n", pl.per, pl.k, pl.n*gen_getwidth(), 
+		   pl.div/256.0, ((pl.div&0xff)==0)?"(int)":"", pl.freq, pl.ppm);
+}
+
+/*
+ * Sequence of segments <mode>:<dur>:<n>, n periods of mode waveform with duration dur, looping unless 'once'
+ * The other shape parameters are taken from the last channel definition.
+ */
+c1seg_t mon_segs[GEN_MAXSEG];
+void mon_seq(void)
+{
+	c1cmd_t cmd;
+	c1seg_t *sq;
+	char *p;
+	int i, j;
+
+	if (nargs<3) { printf("ERR syntax\n"); return; }
+	cmd.cmd = CORE1_SEQ;
+	cmd.ch = mon_getch(1);
+	cmd.val = 1.0;
+	cmd.seq = mon_segs;
+	core1_sync();															// Previous sequence done
+	for (i=2, j=0; i<nargs; i++)
+	{
+		if (strcmp(argv[i], "once")==0) { cmd.val = 0.0; continue; }
+		if (j>=GEN_MAXSEG) { printf("ERR segments\n"); return; }
+		sq = &mon_segs[j];
+		sq->def = core1_def[cmd.ch];
+		for (sq->def.mode=0; sq->def.mode<HMI_NMODE; sq->def.mode++)
+			if (strncmp(argv[i], mon_mode[sq->def.mode], 3)==0) break;
+		p = strchr(argv[i], ':');
+		if ((sq->def.mode>=HMI_NMODE) || (p==NULL)) { printf("ERR segment %d\n", j+1); return; }
+		sq->def.time = atof(p+1);
+		p = strchr(p+1, ':');
+		sq->n = (p==NULL) ? 1 : atoi(p+1);
+		if ((sq->def.time<=0.0) || (sq->n<1)) { printf("ERR segment %d\n", j+1); return; }
+		j++;
+	}
+	cmd.arg = j;
+	core1_post(&cmd);
+	core1_sync();
+	printf("%c seq %d %s\n", 'A'+cmd.ch, j, core1_ok ? ((cmd.val!=0.0) ? "loop" : "once") : "ERR");
+}
+
+/*
+ * Frequency sweep of the channel waveform: sweep <a|b> <f0> <f1> <n> <dwell> [log]
+ * Without frequencies, the index of the active point is printed.
+ */
+void mon_sweep(void)
+{
+	c1cmd_t cmd;
+
+	cmd.ch = mon_getch(1);
+	if (nargs<6)
+	{
+		printf("%c point=%lu\n", 'A'+cmd.ch, gen_sweeppos(cmd.ch));
+		return;
+	}
+	cmd.cmd = CORE1_SWEEP;
+	cmd.sweep.f0 = atof(argv[2]);
+	cmd.sweep.f1 = atof(argv[3]);
+	cmd.sweep.n = atoi(argv[4]);
+	cmd.sweep.dwell = atof(argv[5]);
+	cmd.sweep.log = ((nargs>6) && (strcmp(argv[6], "log")==0));
+	if ((cmd.sweep.dwell<=0.0) || (cmd.sweep.dwell>gen_maxdwell())) { printf("ERR dwell 0..%.3f s\n", gen_maxdwell()); return; }
+	core1_post(&cmd);
+	core1_sync();
+	printf("%c sweep %lu %s\n", 'A'+cmd.ch, cmd.sweep.n, core1_ok ? (cmd.sweep.log ? "log" : "lin") : "ERR");
+}
+
+/*
+ * Modulation of the channel waveform: mod <a|b> <am|fm|pm> <fm> <depth>, or mod <a|b> off
+ * The depth is the AM index [0..1], the FM peak deviation [Hz] or the PM peak deviation [rad].
+ */
+void mon_mod(void)
+{
+	c1cmd_t cmd;
+
+	if (nargs<3) return;
+	cmd.ch = mon_getch(1);
+	if (strcmp(argv[2], "off")==0)											// Back to the plain waveform
+	{
+		core1_sync();
+		cmd.cmd = CORE1_DEF;
+		cmd.def = core1_def[cmd.ch];
+		core1_post(&cmd);
+		printf("%c mod off\n", 'A'+cmd.ch);
+		return;
+	}
+	if (nargs<5) return;
+	cmd.cmd = CORE1_MOD;
+	if (strcmp(argv[2], "am")==0) cmd.mod.mode = MOD_AM;
+	else if (strcmp(argv[2], "fm")==0) cmd.mod.mode = MOD_FM;
+	else if (strcmp(argv[2], "pm")==0) cmd.mod.mode = MOD_PM;
+	else { printf("ERR mode\n"); return; }
+	cmd.mod.fm = atof(argv[3]);
+	cmd.mod.depth = atof(argv[4]);
+	core1_post(&cmd);
+	core1_sync();
+	printf("%c mod %s %.1f Hz%s\n", 'A'+cmd.ch, argv[2], cmd.mod.fm, core1_ok ? "" : " ERR");
+}
+
+/*
+ * LCR measurement with a stimulus near freq on channel A, waits for the result
+ */
+void mon_lcr(void)
+{
+	lcr_t res;
+	double f;
+
+	if (nargs<2) return;
+	f = atof(argv[1]);
+	if (f<=0.0) return;
+	if (lcr_start(f, 0) == 0.0) return;										// Busy
+	while (!lcr_result(&res))
+		tight_loop_contents();
+	printf("f=%.3f vs=%.4f vx=%.4f phase=%.2f r=%g x=%g l=%g c=%g\n", res.freq, res.vs, res.vx, res.phase,
+		   res.r, res.x, res.l, res.c);
 }
 
+/*
+ * Print telemetry: channel stalls, FIFO level, DMA errors and reload rate, and the probed cycle costs
+ * The reload rate is counted during STATS_WINDOW msec, 'stats clr' clears the accumulated statistics.
+ */
+void mon_stats(void)
+{
+	const char *mode[] = {"loop", "stream", "idle", "burst", "seq"};
+	chstat_t *cs;
+	probe_t *pr;
+	const char *name[STATS_NPROBE] = {"gen_play", "genwave", "lcd"};
+	uint32_t reloads[GEN_NCH];
+	int ch, i;
+
+	if ((nargs>1) && (strcmp(argv[1], "clr")==0))
+	{
+		stats_clear();
+		printf("stats cleared\n");
+		return;
+	}
+	gen_count(true);														// Reload counting window
+	sleep_ms(STATS_WINDOW);
+	stats_sample();
+	gen_count(false);
+	for (ch=0; ch<GEN_NCH; ch++)
+		reloads[ch] = stats_ch[ch].hw.reloads;
+	for (ch=0; ch<GEN_NCH; ch++)
+	{
+		cs = &stats_ch[ch];
+		if (cs->nsample == 0) continue;
+		printf("%c %s: fifo=%lu min=%lu stall=%lu/%lu err=%lu dma=%lx reload=%s%lu/s\n", 'A'+ch, mode[cs->hw.mode],
+			   cs->hw.level, cs->minlevel, cs->nstall, cs->nsample, cs->nerr, cs->hw.err,
+			   (reloads[ch] >= GEN_MAXCOUNT) ? ">" : "", reloads[ch]*(1000/STATS_WINDOW));
+	}
+	for (i=0; i<STATS_NPROBE; i++)
+	{
+		pr = &stats_probe[i];
+		if (pr->n == 0) continue;
+		if (STATS_USEC & (1u<<i))
+			printf("%-8s n=%lu min=%lu avg=%lu max=%lu us\n", name[i], pr->n, pr->min, (uint32_t)(pr->sum/pr->n), pr->max);
+		else
+			printf("%-8s n=%lu min=%lu avg=%lu max=%lu cycles, max %.1f us\n", name[i], pr->n, pr->min,
+				   (uint32_t)(pr->sum/pr->n), pr->max, pr->max*1.0e6/_fsys);
+	}
+}
+
+/*
+ * Presets in flash, slot PRESET_BOOT is restored at power up
+ * Syntax: preset <save|load> [slot], preset list, preset erase
+ */
+void mon_preset(void)
+{
+	const prrec_t *pr;
+	const ch_t *d;
+	int slot, ch;
+
+	if (nargs<2) { printf("ERR syntax\n"); return; }
+	slot = (nargs>2) ? atoi(argv[2]) : PRESET_BOOT;
+	if (strncmp(argv[1], "save", 4) == 0)
+	{
+		if (!preset_save(slot)) { printf("ERR slot 0..%d\n", PRESET_NSLOT-1); return; }
+		printf("Preset %d saved, %lu bytes free\n", slot, preset_free());
+	}
+	else if (strncmp(argv[1], "load", 4) == 0)
+	{
+		if (!preset_load(slot)) { printf("ERR no preset %d\n", slot); return; }
+		printf("Preset %d loaded\n", slot);
+	}
+	else if (strncmp(argv[1], "list", 4) == 0)
+	{
+		for (slot=0; slot<PRESET_NSLOT; slot++)
+		{
+			if ((pr = preset_get(slot)) == NULL) continue;
+			printf("%d: %d bit", slot, 8*pr->width);
+			for (ch=0; ch<((pr->width == GEN_WIDTH16)?1:GEN_NCH); ch++)
+			{
+				d = &pr->def[ch];
+				if (pr->len[ch] > 0)
+					printf(" %c=load %lu bytes %g s", 'A'+ch, pr->len[ch], pr->dur[ch]);
+				else
+					printf(" %c=%s %g s %d/%d/%d", 'A'+ch, mon_mode[d->mode%HMI_NMODE], d->time, d->duty, d->rise, d->fall);
+			}
+			printf("\n");
+		}
+		printf("%lu bytes free\n", preset_free());
+	}
+	else if (strncmp(argv[1], "erase", 5) == 0)
+	{
+		preset_erase();
+		printf("Presets erased\n");
+	}
+	else
+		printf("ERR syntax\n");
+}
+
+/*
+ * DAC correction tables, see cal.c
+ * Syntax: cal [a|b], cal <a|b> <measure|load|off>, cal save
+ * A new table is applied by synthesizing the last channel definition again.
+ */
+void mon_cal(void)
+{
+	uint8_t lut[GEN_CALLEN] __attribute__((aligned(4)));
+	const uint8_t *t;
+	uint8_t hdr[4];
+	c1cmd_t cmd;
+	int ch, i;
+
+	if (nargs<2)
+	{
+		for (ch=0; ch<GEN_NCH; ch++)
+			printf("%c %s\n", 'A'+ch, (gen_getcal(ch) != NULL) ? "corrected" : "uncorrected");
+		return;
+	}
+	if (strncmp(argv[1], "save", 4) == 0)
+	{
+		printf(preset_savecal() ? "Tables saved\n" : "ERR flash\n");
+		return;
+	}
+	ch = mon_getch(1);
+	if (nargs<3)															// Print table
+	{
+		if ((t = gen_getcal(ch)) == NULL) { printf("%c uncorrected\n", 'A'+ch); return; }
+		for (i=0; i<GEN_CALLEN; i++)
+			printf("%02x%c", t[i], ((i&15)==15) ? '\n' : ' ');
+		return;
+	}
+	if (strncmp(argv[2], "measure", 4) == 0)
+	{
+		if (!cal_measure(ch, lut)) printf("ERR no levels on ADC0\n");
+		else { core1_sync(); gen_setcal(ch, lut); }
+	}
+	else if (strncmp(argv[2], "load", 4) == 0)
+	{
+		printf("Ready\n");
+		if (mon_getbin(lut, GEN_CALLEN) < GEN_CALLEN) { printf("Cal: timeout\n"); return; }
+		if (mon_getbin(hdr, 4) < 4) { printf("Cal: timeout\n"); return; }
+		if ((hdr[0] | (hdr[1]<<8) | (hdr[2]<<16) | (hdr[3]<<24)) != mon_crc32(lut, GEN_CALLEN)) { printf("Cal: CRC error\n"); return; }
+		core1_sync();
+		gen_setcal(ch, lut);
+	}
+	else if (strncmp(argv[2], "off", 3) == 0)
+	{
+		core1_sync();
+		gen_setcal(ch, NULL);
+	}
+	else { printf("ERR syntax\n"); return; }
+
+	cmd.cmd = CORE1_DEF;
+	cmd.ch = ch;
+	cmd.def = core1_def[ch];
+	core1_post(&cmd);
+	core1_sync();
+	printf("%c %s\n", 'A'+ch, (gen_getcal(ch) != NULL) ? "corrected" : "uncorrected");
+}
+
+/*
+ * Start or stop a channel, a stopped output holds its last sample
+ */
+void mon_enable(bool on)
+{
+	c1cmd_t cmd;
+
+	cmd.cmd = CORE1_EN;
+	cmd.ch = mon_getch(1);
+	cmd.val = on?1.0:0.0;
+	core1_post(&cmd);
+	core1_sync();
+	printf("%c %s\n", 'A'+cmd.ch, on?"start":"stop");
+}
+void mon_start(void) { mon_enable(true); }
+void mon_stop(void) { mon_enable(false); }
+
 /*
  * Command shell table, organize the command functions above
  */
-#define NCMD	1
+#define NCMD	25
 shell_t shell[NCMD]=
 {
-	{"fsys", 4, &mon_fsys, "fsys", "Print system clock frequency"}
+	{"fsys", 4, &mon_fsys, "fsys", "Print system clock frequency"},
+	{"clock", 5, &mon_clock, "clock [kHz]", "Set system clock, e.g. 250000 for maximum sample rate"},
+	{"stream", 6, &mon_stream, "stream <a|b> <rate>", "Stream binary samples from stdin at rate [Hz]"},
+	{"dds", 3, &mon_dds, "dds <a|b> <freq> [sin|saw|f]", "DDS output at freq [Hz], f only changes frequency"},
+	{"sync", 4, &mon_sync, "sync [phase]", "Restart A and B in sync, B lagging phase [deg]"},
+	{"width", 5, &mon_width, "width <8|16>", "Two 8 bit channels, or channel A only with 16 bit samples"},
+	{"burst", 5, &mon_burst, "burst <a|b> <n> [idle]", "Play n periods on a rising edge of GP18, then hold idle level"},
+	{"trig", 4, &mon_trig, "trig [a|b]", "Software trigger of an armed burst"},
+	{"load", 4, &mon_load, "load <a|b> <dur>", "Binary upload: <len><samples><crc32>, of dur [s] per period"},
+	{"mode", 4, &mon_setmode, "mode <a|b> <sqr|tri|saw|sin|pul>", "Set waveform shape"},
+	{"time", 4, &mon_settime, "time <a|b> <dur>", "Set waveform period [s]"},
+	{"duty", 4, &mon_setduty, "duty <a|b> <pct>", "Set pulse duty cycle [%]"},
+	{"rise", 4, &mon_setrise, "rise <a|b> <pct>", "Set pulse rise time [% of period]"},
+	{"fall", 4, &mon_setfall, "fall <a|b> <pct>", "Set pulse fall time [% of period]"},
+	{"rate", 4, &mon_rate, "rate <a|b>", "Print channel state, actual divider and sample rate"},
+	{"plan", 4, &mon_plan, "plan <freq> [nmin] [ppm]", "Print frequency plan: periods, samples, divider and error"},
+	{"seq", 3, &mon_seq, "seq <a|b> <mode>:<dur>:<n>.. [once]", "Play segments, n periods each, looping unless once"},
+	{"sweep", 5, &mon_sweep, "sweep <a|b> [<f0> <f1> <n> <dwell> [log]]", "Frequency sweep in n points of dwell [s], or print point"},
+	{"mod", 3, &mon_mod, "mod <a|b> <am|fm|pm|off> [<fm> <depth>]", "Modulate at fm [Hz]; depth AM index, FM [Hz] or PM [rad]"},
+	{"lcr", 3, &mon_lcr, "lcr <freq>", "Measure DUT impedance, with a sine on channel A near freq [Hz]"},
+	{"stats", 5, &mon_stats, "stats [clr]", "Print output stalls, DMA errors and reload rate, and cycle costs"},
+	{"preset", 6, &mon_preset, "preset <save|load|list|erase> [slot]", "Presets in flash, slot 0 is restored at power up"},
+	{"cal", 3, &mon_cal, "cal [a|b] [measure|load|off] | cal save", "DAC correction: print, measure on ADC0, upload <256 bytes><crc32>, or save in flash"},
+	{"start", 5, &mon_start, "start <a|b>", "Start channel output"},
+	{"stop", 4, &mon_stop, "stop <a|b>", "Stop channel output, holding the last sample"}
 };
 
 
@@ -126,16 +802,14 @@ void mon_parse(char* s)
  * Monitor process 
  * This function collects characters from stdin until CR
  * Then the command is send to a parser and executed.
+ * It is run by the scheduler when characters are available, and handles all of them. 
+ * After MON_MAX_US the other tasks get a turn, and the monitor is posted again.
  */
+#define MON_MAX_US		50000L
 char mon_cmd[CMD_LEN+1];										// Command string buffer
 int  mon_pos = 0;												// Current position in command string
-void mon_evaluate(void)
+void mon_char(int c)
 {
-	int c;
-
-	c = getchar_timeout_us(10L);								// NOTE: this is the only SDK way to read from stdin
-	if (c==PICO_ERROR_TIMEOUT) return;							// Early bail out
-	
 	switch (c)
 	{
 	case BS:
@@ -163,3 +837,19 @@ void mon_evaluate(void)
 		break;
 	}
 }
+void mon_evaluate(void)
+{
+	int c;
+	uint32_t t;
+
+	t = time_us_32();
+	while ((c = getchar_timeout_us(0)) != PICO_ERROR_TIMEOUT)				// NOTE: this is the only SDK way to read from stdin
+	{
+		mon_char(c);
+		if ((time_us_32()-t) > MON_MAX_US)									// Give other tasks a turn
+		{
+			sched_post(SCHED_MON);
+			break;
+		}
+	}
+}
@@ -0,0 +1,136 @@
+/*
+ * plan.c
+ *
+ * Created: Jan 2022
+ * Author: Arjan te Marvelde
+ * 
+ * The frequency planner.
+ *
+ * The output frequency is f = fsys / (d * k), where d is the PIO divider in 1/256 steps and k the nr of samples
+ * in one period. Just rounding the divider for a fixed k, as done from the waveform time, easily gives errors of 
+ * hundreds of ppm at higher frequencies. Searching all k from nmin up to the buffer size, with a rounded fractional
+ * and a rounded integer divider each, mostly gives an exact or sub-ppm solution.
+ *
+ * The buffer must be a multiple of 4 bytes and at least GEN_MINBUFLEN long, so for odd k the buffer holds 
+ * more than one period. This does not affect the frequency, only the buffer length.
+ * Shorter buffers are allowed when the length is a power of two, these are played with the DMA read ring.
+ *
+ * A fractional divider jitters one system clock on the sample moments, so integer dividers are preferred.
+ * Within the tolerance, the order of preference is: integer divider, more samples per period, smaller error.
+ * When no plan meets the tolerance, the one with smallest error is taken.
+ */
+
+#include <math.h>
+#include "pico/stdlib.h"
+
+#include "gen.h"
+#include "plan.h"
+
+#define PLAN_DMIN		(1U<<8)												// Divider range, in 1/256
+#define PLAN_DMAX		(65535U<<8)
+
+/*
+ * Returns true when a is a better plan than b
+ */
+static bool plan_better(plan_t *a, plan_t *b, float tol)
+{
+	bool aok = (fabs(a->ppm) <= tol);
+	bool bok = (fabs(b->ppm) <= tol);
+	bool aint = ((a->div & 0xff) == 0);
+	bool bint = ((b->div & 0xff) == 0);
+
+	if (aok != bok) return aok;												// Within tolerance first
+	if (!aok) return (fabs(a->ppm) < fabs(b->ppm));							// Both outside: smallest error
+	if (aint != bint) return aint;											// Integer divider
+	if (a->k != b->k) return (a->k > b->k);									// Resolution
+	return (fabs(a->ppm) < fabs(b->ppm));
+}
+
+/*
+ * Find the nr of periods in the buffer for k samples per period, returns 0 if none fits
+ */
+static uint32_t plan_periods(uint32_t k, int wid, uint32_t maxlen, uint32_t maxper)
+{
+	uint32_t p, n;
+
+	for (p=1; p<=maxper; p++)
+	{
+		n = k*p*wid;														// Buffer length in bytes
+		if (n > maxlen) break;												// Does not fit
+		if (n%4 != 0) continue;												// Whole words
+		if ((n >= GEN_MINBUFLEN) || ((n >= GEN_MINRINGLEN) && !(n&(n-1)))) return p;	// Long enough, or ring
+	}
+	return 0;
+}
+
+/*
+ * Find the best plan for freq, with at least nmin samples per period and at most maxper periods in maxlen bytes
+ * The sample width follows gen_getwidth().
+ * When freq is too high for nmin, the minimum is lowered to what fits at divider 1.
+ * Returns true when the error is within tol ppm.
+ */
+bool plan_fit(double freq, uint32_t nmin, uint32_t maxlen, uint32_t maxper, float tol, plan_t *pl)
+{
+	plan_t c, best;
+	int wid = gen_getwidth();
+	uint32_t k, kmax, i;
+	float x, ratio;
+
+	ratio = (float)(_fsys * 256.0 / freq);									// d*k, in 1/256
+	if (maxlen > gen_maxlen()) maxlen = gen_maxlen();
+	kmax = maxlen/wid;
+	if (nmin > kmax) nmin = kmax;
+	if (ratio/PLAN_DMIN < nmin)												// Too high for nmin
+		nmin = (ratio/PLAN_DMIN < 2)?2:(uint32_t)(ratio/PLAN_DMIN);
+	
+	best.k = 0;
+	for (k=nmin; k<=kmax; k++)
+	{
+		c.per = plan_periods(k, wid, maxlen, maxper);
+		if (c.per == 0) continue;
+		c.k = k;
+		c.n = k*c.per;
+		x = ratio/k;														// Exact divider
+		for (i=0; i<2; i++)
+		{
+			if (i==0)
+				c.div = (uint32_t)(x + 0.5f);								// Fractional divider
+			else
+				c.div = (uint32_t)(x/256.0f + 0.5f) << 8;					// Integer divider
+			if (c.div < PLAN_DMIN) c.div = PLAN_DMIN;
+			if (c.div > PLAN_DMAX) c.div = PLAN_DMAX;
+			c.ppm = 1.0e6f*(x/c.div - 1.0f);
+			if ((best.k == 0) || plan_better(&c, &best, tol))
+				best = c;
+		}
+	}
+	if (best.k == 0)														// Nothing fits, e.g. maxper too low
+	{
+		best.per = 1;
+		best.k = kmax & ~(4/wid - 1);
+		best.n = best.k;
+		best.div = PLAN_DMIN;
+	}
+
+	/* Achieved values, in double */
+	best.freq = _fsys * 256.0 / ((double)best.div * best.k);
+	best.ppm = 1.0e6 * (best.freq - freq) / freq;
+	*pl = best;
+	return (fabs(best.ppm) <= tol);
+}
+
+/*
+ * Find the best plan for freq that fits in a generator buffer
+ */
+bool plan_find(double freq, uint32_t nmin, uint32_t maxper, float tol, plan_t *pl)
+{
+	return plan_fit(freq, nmin, gen_maxlen(), maxper, tol, pl);
+}
+
+/*
+ * Buffer duration for a plan, gen_play() derives the divider from this
+ */
+double plan_dur(plan_t *pl)
+{
+	return (double)pl->div * pl->n / (256.0 * _fsys);
+}
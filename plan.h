@@ -0,0 +1,39 @@
+#ifndef __PLAN_H__
+#define __PLAN_H__
+/* 
+ * plan.h
+ *
+ * Created: Jan 2022
+ * Author: Arjan te Marvelde
+ *
+ * See plan.c for more information 
+ */
+
+#define PLAN_NMIN		64													// Default minimum samples per period
+#define PLAN_MAXPER		16													// Default maximum periods in buffer
+#define PLAN_TOL		1.0													// Default frequency tolerance [ppm]
+
+/*
+ * The result of a frequency plan
+ * The buffer holds per periods of k samples, played with a PIO divider of div/256.
+ */
+typedef struct
+{
+	uint32_t per;															// Periods in buffer
+	uint32_t k;																// Samples per period
+	uint32_t n;																// Samples in buffer, per*k
+	uint32_t div;															// PIO divider, in 1/256
+	double   freq;															// Achieved frequency [Hz]
+	double   ppm;															// Frequency error [ppm]
+} plan_t;
+
+/* Find the best plan for freq, returns true when within tol [ppm] */
+bool plan_find(double freq, uint32_t nmin, uint32_t maxper, float tol, plan_t *pl);
+
+/* Same, with the buffer limited to maxlen bytes */
+bool plan_fit(double freq, uint32_t nmin, uint32_t maxlen, uint32_t maxper, float tol, plan_t *pl);
+
+/* Buffer duration for a plan, as used by gen_play() */
+double plan_dur(plan_t *pl);
+
+#endif
@@ -0,0 +1,433 @@
+/*
+ * preset.c
+ *
+ * Created: Jan 2022
+ * Author: Arjan te Marvelde
+ *
+ * Channel presets in flash, restored at power up.
+ *
+ * A preset holds the output width and the channel definitions, and for a channel that plays loaded samples (see
+ * the monitor load command) also these samples. There are PRESET_NSLOT slots, slot PRESET_BOOT is restored at boot.
+ * The samples are saved as played, i.e. as DAC codes after correction, so they are restored with CORE1_DAC.
+ * One more slot, PRESET_CAL, holds the DAC correction tables (see gen_setcal()) in place of samples.
+ *
+ * The last 2*PRESET_BANKLEN bytes of flash are two banks, one of them is active. A bank starts with a page that
+ * holds its generation, followed by page aligned records that are only appended: a save writes a new record for the
+ * slot, the last valid record of a slot is the one that counts. When the active bank is full, the last record
+ * of each slot is copied into the other bank, which is erased first, and at last the bank page is written with the
+ * next generation. The bank with a valid bank page and the highest generation is the active one, so an interrupted
+ * copy or save leaves the previous state. Each bank is erased only once per round of saves that fills it.
+ *
+ * At boot preset_init() finds the records before the generator is started, and hands the samples of the boot
+ * preset to gen_init(), which copies them from XIP into its buffers. The samples are not played from XIP flash:
+ * DMA can not sustain the sample rate from there, and flash is not readable while a record is written.
+ * After core1_init() the boot preset is restored as a whole with preset_load(), which synthesizes the defined
+ * waveforms on core 1, well within a millisecond.
+ *
+ * While flash is written, core 1 is parked in RAM with its interrupts disabled (see core1_lockout()) and the
+ * core 0 interrupts are disabled. The outputs keep playing from SRAM, but streaming and DDS halt during a write.
+ * A bank is erased sector by sector, so each halt is one sector erase or page program, see preset_flash().
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stddef.h>
+#include "pico/stdlib.h"
+#include "hardware/flash.h"
+#include "hardware/sync.h"
+
+#include "gen.h"
+#include "hmi.h"
+#include "core1.h"
+#include "preset.h"
+
+#define PRESET_MAGIC	0x53455250											// "PRES", record
+#define PRESET_BMAGIC	0x4b4e4142											// "BANK", bank page
+#define PRESET_ERASED	0xffffffff
+
+/*
+ * Bank page, gen and ngen are each other's complement
+ */
+typedef struct
+{
+	uint32_t magic;															// PRESET_BMAGIC
+	uint32_t gen;															// Generation, the highest is active
+	uint32_t ngen;
+} prbank_t;
+
+int		 preset_bank = -1;													// Active bank, -1 when there is none
+uint32_t preset_gen;														// Generation of the active bank
+uint32_t preset_end;														// Flash offset of the first free page
+const prrec_t *preset_rec[PRESET_CAL+1];									// Last valid record of each slot, in XIP
+
+uint8_t  preset_page[FLASH_PAGE_SIZE] __attribute__((aligned(4)));			// Page to program
+uint32_t preset_pos;														// Bytes in preset_page
+uint32_t preset_dst;														// Flash offset of preset_page
+
+
+static inline const void *preset_xip(uint32_t off)
+{
+	return (const void *)(XIP_BASE + off);
+}
+
+static inline uint32_t preset_base(int bank)
+{
+	return PRESET_OFFSET + bank*PRESET_BANKLEN;
+}
+
+/*
+ * Samples of channel ch in a record, after those of the lower channels
+ */
+static const uint8_t *preset_samples(const prrec_t *r, int ch)
+{
+	const uint8_t *p = (const uint8_t *)r + sizeof(prrec_t);
+	int i;
+
+	for (i=0; i<ch; i++)
+		p += r->len[i];
+	return p;
+}
+
+/*
+ * Running CRC-32, reflected IEEE 802.3 polynomial, start with PRESET_ERASED and invert the result
+ * This gives the same value as the monitor load command.
+ */
+static uint32_t preset_crc(uint32_t crc, const uint8_t *p, uint32_t n)
+{
+	int i;
+
+	while (n--)
+	{
+		crc ^= *p++;
+		for (i=0; i<8; i++)
+			crc = (crc & 1) ? (crc >> 1) ^ 0xedb88320 : (crc >> 1);
+	}
+	return crc;
+}
+
+static uint32_t preset_reccrc(const prrec_t *r, const uint8_t *smp[GEN_NCH])
+{
+	uint32_t crc;
+	int ch;
+
+	crc = preset_crc(PRESET_ERASED, (const uint8_t *)&r->slot, sizeof(prrec_t) - offsetof(prrec_t, slot));
+	for (ch=0; ch<GEN_NCH; ch++)
+		crc = preset_crc(crc, smp[ch], r->len[ch]);
+	return ~crc;
+}
+
+/*
+ * Check a record header and its CRC, the size has been checked before
+ */
+static bool preset_valid(const prrec_t *r)
+{
+	const uint8_t *smp[GEN_NCH];
+	int ch;
+
+	if (r->slot > PRESET_CAL) return false;
+	if ((r->width != GEN_WIDTH8) && (r->width != GEN_WIDTH16)) return false;
+	for (ch=0; ch<GEN_NCH; ch++)
+	{
+		if ((r->len[ch] > 2*GEN_MAXBUFLEN) || (r->len[ch]&3)) return false;	// See gen_alloclen()
+		smp[ch] = preset_samples(r, ch);
+	}
+	if (preset_samples(r, GEN_NCH) > (const uint8_t *)r + r->size) return false;
+	return (preset_reccrc(r, smp) == r->crc);
+}
+
+/*
+ * Find the active bank, and the last valid record of each slot in it
+ * A record that is not valid is skipped, without a proper header the rest of the bank is taken as used.
+ */
+static void preset_scan(void)
+{
+	const prbank_t *bk;
+	const prrec_t *r;
+	uint32_t off, end;
+	int b;
+
+	memset(preset_rec, 0, sizeof(preset_rec));
+	preset_bank = -1;
+	for (b=0; b<2; b++)
+	{
+		bk = preset_xip(preset_base(b));
+		if ((bk->magic != PRESET_BMAGIC) || (bk->gen != ~bk->ngen)) continue;
+		if ((preset_bank < 0) || (bk->gen > preset_gen))
+		{
+			preset_bank = b;
+			preset_gen = bk->gen;
+		}
+	}
+	if (preset_bank < 0) return;
+
+	off = preset_base(preset_bank) + FLASH_PAGE_SIZE;
+	end = preset_base(preset_bank) + PRESET_BANKLEN;
+	while (off < end)
+	{
+		r = preset_xip(off);
+		if (r->magic == PRESET_ERASED) break;								// Free from here
+		if ((r->magic != PRESET_MAGIC) || (r->size == 0) || (r->size%FLASH_PAGE_SIZE) || (r->size > end-off))
+		{
+			off = end;														// Full until the next copy
+			break;
+		}
+		if (preset_valid(r))
+			preset_rec[r->slot] = r;
+		off += r->size;
+	}
+	preset_end = off;
+}
+
+/*
+ * Erase (data is NULL) or program n bytes of flash at offset off, n a multiple of sector or page size
+ * An erase is done one sector at a time, with core 1 released and the interrupts enabled in between, so USB, the
+ * timers and the generator service are held up by one sector erase at most, not by a whole bank.
+ * Core 1 must be running core1_main(), see core1_init().
+ */
+static void preset_flash(uint32_t off, const uint8_t *data, uint32_t n)
+{
+	uint32_t irq, i;
+
+	for (i=0; i<n; i+=FLASH_SECTOR_SIZE)
+	{
+		core1_lockout();													// Core 1 waits in RAM
+		irq = save_and_disable_interrupts();
+		if (data == NULL)
+			flash_range_erase(off+i, FLASH_SECTOR_SIZE);
+		else
+			flash_range_program(off+i, &data[i], (n-i < FLASH_SECTOR_SIZE) ? n-i : FLASH_SECTOR_SIZE);
+		restore_interrupts(irq);
+		core1_release();
+	}
+}
+
+/*
+ * Sequential programming through preset_page, starting at flash offset off
+ * The source may be in XIP flash, it is read before each page is programmed.
+ */
+static void preset_open(uint32_t off)
+{
+	preset_dst = off;
+	preset_pos = 0;
+}
+
+static void preset_put(const void *src, uint32_t n)
+{
+	const uint8_t *p = src;
+	uint32_t k;
+
+	while (n > 0)
+	{
+		k = FLASH_PAGE_SIZE - preset_pos;
+		if (k > n) k = n;
+		memcpy(&preset_page[preset_pos], p, k);
+		preset_pos += k; p += k; n -= k;
+		if (preset_pos == FLASH_PAGE_SIZE)
+		{
+			preset_flash(preset_dst, preset_page, FLASH_PAGE_SIZE);
+			preset_dst += FLASH_PAGE_SIZE;
+			preset_pos = 0;
+		}
+	}
+}
+
+static void preset_close(void)
+{
+	if (preset_pos == 0) return;
+	memset(&preset_page[preset_pos], 0xff, FLASH_PAGE_SIZE - preset_pos);	// Leave the rest erased
+	preset_flash(preset_dst, preset_page, FLASH_PAGE_SIZE);
+	preset_dst += FLASH_PAGE_SIZE;
+	preset_pos = 0;
+}
+
+/*
+ * Copy the last records into the other bank, except the one of slot skip, and make it the active bank
+ * Without an active bank, this formats bank 0.
+ */
+static void preset_copy(int skip)
+{
+	prbank_t bk;
+	uint32_t base;
+	int b, s;
+
+	b = (preset_bank < 0) ? 0 : 1-preset_bank;
+	base = preset_base(b);
+	preset_flash(base, NULL, PRESET_BANKLEN);
+	preset_open(base + FLASH_PAGE_SIZE);
+	for (s=0; s<=PRESET_CAL; s++)
+		if ((s != skip) && (preset_rec[s] != NULL))
+			preset_put(preset_rec[s], preset_rec[s]->size);					// Page aligned, as is
+	preset_close();
+
+	bk.magic = PRESET_BMAGIC;
+	bk.gen = (preset_bank < 0) ? 1 : preset_gen+1;
+	bk.ngen = ~bk.gen;
+	preset_open(base);
+	preset_put(&bk, sizeof(bk));											// Commit
+	preset_close();
+	preset_scan();
+}
+
+/*
+ * Append a record, copying to the other bank first when it does not fit
+ */
+static bool preset_write(prrec_t *r, const uint8_t *smp[GEN_NCH])
+{
+	int ch;
+
+	r->magic = PRESET_MAGIC;
+	r->size = preset_samples(r, GEN_NCH) - (const uint8_t *)r;
+	r->size = (r->size + FLASH_PAGE_SIZE-1) & ~(FLASH_PAGE_SIZE-1);
+	r->crc = preset_reccrc(r, smp);
+	if ((preset_bank < 0) || (r->size > preset_free()))
+		preset_copy(r->slot);
+	if (r->size > preset_free()) return false;								// All slots are too large
+
+	preset_open(preset_end);
+	preset_put(r, sizeof(prrec_t));
+	for (ch=0; ch<GEN_NCH; ch++)
+		preset_put(smp[ch], r->len[ch]);
+	preset_close();
+	preset_scan();
+	return (preset_rec[r->slot] != NULL);									// Read back
+}
+
+
+/*** Interface ***/
+
+const prrec_t *preset_get(int slot)
+{
+	if ((uint)slot >= PRESET_NSLOT) return NULL;
+	return preset_rec[slot];
+}
+
+uint32_t preset_free(void)
+{
+	if (preset_bank < 0) return PRESET_BANKLEN - FLASH_PAGE_SIZE;
+	return preset_base(preset_bank) + PRESET_BANKLEN - preset_end;
+}
+
+/*
+ * Save the state of core 1 in a slot
+ * Loaded samples are saved for a channel that plays them in loop mode, otherwise its definition is used.
+ */
+bool preset_save(int slot)
+{
+	prrec_t r;
+	wfg_t wf;
+	const uint8_t *smp[GEN_NCH];
+	int ch;
+
+	if ((uint)slot >= PRESET_NSLOT) return false;
+	core1_sync();															// State of core 1 is stable
+	memset(&r, 0, sizeof(r));												// Padding is in the CRC
+	r.slot = slot;
+	r.width = gen_getwidth();
+	for (ch=0; ch<GEN_NCH; ch++)
+	{
+		r.def[ch] = core1_def[ch];
+		smp[ch] = NULL;
+		if (core1_arb[ch] && gen_getwave(ch, &wf))
+		{
+			r.len[ch] = wf.len;
+			r.dur[ch] = wf.dur;
+			smp[ch] = wf.buf;
+		}
+	}
+	return preset_write(&r, smp);
+}
+
+/*
+ * Restore a slot, by posting its width, definitions and samples to core 1
+ */
+bool preset_load(int slot)
+{
+	const prrec_t *r = preset_get(slot);
+	c1cmd_t cmd;
+	int ch;
+
+	if (r == NULL) return false;
+	core1_sync();
+	if (r->width != gen_getwidth())
+	{
+		cmd.cmd = CORE1_WIDTH;
+		cmd.val = r->width;
+		core1_post(&cmd);
+	}
+	for (ch=0; ch<GEN_NCH; ch++)
+	{
+		if ((r->width == GEN_WIDTH16) && (ch != OUTA)) break;
+		cmd.ch = ch;
+		if (r->len[ch] > 0)
+		{
+			cmd.cmd = CORE1_TAKE;											// No DDS or modulation writing the buffers
+			core1_post(&cmd);
+			core1_sync();													// Core 1 done with the buffers
+			cmd.cmd = CORE1_DAC;
+			cmd.wave.buf = gen_alloc(ch, r->len[ch]) ? gen_loadbuf(ch) : NULL;
+			if (cmd.wave.buf == NULL) continue;
+			memcpy(cmd.wave.buf, preset_samples(r, ch), r->len[ch]);		// From XIP to SRAM
+			cmd.wave.len = r->len[ch];
+			cmd.wave.dur = r->dur[ch];
+		}
+		else
+		{
+			cmd.cmd = CORE1_DEF;
+			cmd.def = r->def[ch];
+		}
+		core1_post(&cmd);
+	}
+	core1_sync();
+	return true;
+}
+
+bool preset_savecal(void)
+{
+	prrec_t r;
+	const uint8_t *smp[GEN_NCH];
+	int ch;
+
+	core1_sync();
+	memset(&r, 0, sizeof(r));
+	r.slot = PRESET_CAL;
+	r.width = GEN_WIDTH8;
+	for (ch=0; ch<GEN_NCH; ch++)
+	{
+		smp[ch] = gen_getcal(ch);
+		r.len[ch] = (smp[ch] != NULL) ? GEN_CALLEN : 0;
+	}
+	return preset_write(&r, smp);
+}
+
+void preset_erase(void)
+{
+	preset_flash(PRESET_OFFSET, NULL, 2*PRESET_BANKLEN);
+	preset_scan();
+}
+
+/*
+ * Find the records, set the correction tables, and the boot preset samples as initial waveforms of gen_init()
+ * This runs before the generator and core 1 are started, and only reads flash.
+ */
+void preset_init(void)
+{
+	const prrec_t *r;
+	wfg_t wf;
+	int ch;
+
+	preset_scan();
+	r = preset_rec[PRESET_CAL];
+	for (ch=0; (r != NULL) && (ch<GEN_NCH); ch++)
+		if (r->len[ch] == GEN_CALLEN)
+			gen_setcal(ch, preset_samples(r, ch));							// Correction before the first samples
+	r = preset_rec[PRESET_BOOT];
+	if ((r == NULL) || (r->width != GEN_WIDTH8)) return;					// gen_init() starts in 8 bit mode
+	for (ch=0; ch<GEN_NCH; ch++)
+	{
+		if (r->len[ch] == 0) continue;
+		wf.buf = (uint8_t *)preset_samples(r, ch);
+		wf.len = r->len[ch];
+		wf.dur = r->dur[ch];
+		gen_preset(ch, &wf);
+	}
+}
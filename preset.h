@@ -0,0 +1,56 @@
+#ifndef __PRESET_H__
+#define __PRESET_H__
+/*
+ * preset.h
+ *
+ * Created: Jan 2022
+ * Author: Arjan te Marvelde
+ *
+ * See preset.c for more information
+ */
+
+#include "hardware/flash.h"
+#include "gen.h"
+#include "hmi.h"
+
+#define PRESET_NSLOT	8													// Nr of preset slots
+#define PRESET_BOOT		0													// Slot restored at power up
+#define PRESET_CAL		PRESET_NSLOT										// Slot of the DAC correction tables
+#define PRESET_BANKLEN	(16*FLASH_SECTOR_SIZE)								// Size of one of the two flash banks
+#define PRESET_OFFSET	(PICO_FLASH_SIZE_BYTES - 2*PRESET_BANKLEN)			// Flash offset of the bank pair, at the end
+
+/*
+ * Preset record, followed by the samples of the channels that play loaded samples (len>0), A first
+ * The samples are DAC codes, as played, see gen_setcal(). The PRESET_CAL record holds correction tables instead.
+ * The CRC covers the record from slot onwards, including the samples.
+ */
+typedef struct
+{
+	uint32_t magic;															// PRESET_MAGIC
+	uint32_t crc;															// CRC-32 from slot to the end of the samples
+	uint32_t slot;															// Preset slot
+	uint32_t size;															// Bytes in flash, multiple of FLASH_PAGE_SIZE
+	int32_t  width;															// Output width, GEN_WIDTH8 or GEN_WIDTH16
+	ch_t	 def[GEN_NCH];													// Channel definitions
+	uint32_t len[GEN_NCH];													// Sample bytes, 0 for a defined waveform
+	double	 dur[GEN_NCH];													// Duration of the samples [s]
+} prrec_t;
+
+/* Find the valid records, and hand the boot preset samples to gen_init(), call before gen_init() */
+void preset_init(void);
+
+/* Record of a slot in flash, NULL when there is none */
+const prrec_t *preset_get(int slot);
+
+/* Save the channel state in a slot, or restore it, called on core 0 after core1_init() */
+bool preset_save(int slot);
+bool preset_load(int slot);
+
+/* Save the correction tables of the channels, they are set by preset_init() at boot */
+bool preset_savecal(void);
+
+/* Erase all presets and tables, and the flash bytes left for records */
+void preset_erase(void);
+uint32_t preset_free(void);
+
+#endif
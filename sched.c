@@ -0,0 +1,80 @@
+/*
+ * sched.c
+ *
+ * Created: Jan 2022
+ * Author: Arjan te Marvelde
+ * 
+ * Event driven task scheduler for the main loop on core 0.
+ *
+ * Each task is a handler registered for a mask of events. Interrupt handlers and callbacks post events by 
+ * setting their bits in a pending word, followed by a SEV. The scheduler takes and clears the pending word, and 
+ * runs each task that has one of its events pending. When nothing is pending the core sleeps in WFE, until the 
+ * next event or interrupt. 
+ * A post between the check and the WFE sets the event register, so WFE then returns immediately.
+ *
+ * Event sources:
+ * - SCHED_MON: USB CDC characters available callback
+ * - SCHED_HMI: keypad INT GPIO IRQ and debounce alarms
+ * - SCHED_LCD: canvas changes and display flush completion (DMA IRQ)
+ * - SCHED_TICK: slow repeating timer, as fallback for missed events
+ * - SCHED_BOOT: posted once by main(), for the start-up that may block
+ */
+
+#include <stdio.h>
+#include "pico/stdlib.h"
+#include "hardware/sync.h"
+
+#include "sched.h"
+
+#define SCHED_NTASK		8													// Maximum nr of tasks
+
+typedef struct
+{
+	uint32_t	mask;														// Events to run on
+	void	  (*fn)(void);													// Handler
+} task_t;
+
+task_t	 sched_tasks[SCHED_NTASK];
+int		 sched_ntask = 0;
+volatile uint32_t sched_pending;											// Pending events
+
+
+void sched_task(uint32_t mask, void (*fn)(void))
+{
+	if (sched_ntask >= SCHED_NTASK) return;
+	sched_tasks[sched_ntask].mask = mask;
+	sched_tasks[sched_ntask].fn = fn;
+	sched_ntask++;
+}
+
+void sched_post(uint32_t ev)
+{
+	uint32_t save;
+	
+	save = save_and_disable_interrupts();
+	sched_pending |= ev;
+	restore_interrupts(save);
+	__sev();																// Wake from WFE
+}
+
+void sched_run(void)
+{
+	uint32_t ev, save;
+	int i;
+	
+	while (1)
+	{
+		save = save_and_disable_interrupts();
+		ev = sched_pending;													// Take pending events
+		sched_pending = 0;
+		restore_interrupts(save);
+		if (ev == 0)
+		{
+			__wfe();														// Sleep until next event
+			continue;
+		}
+		for (i=0; i<sched_ntask; i++)
+			if (sched_tasks[i].mask & ev)
+				(*sched_tasks[i].fn)();
+	}
+}
@@ -0,0 +1,28 @@
+#ifndef __SCHED_H__
+#define __SCHED_H__
+/* 
+ * sched.h
+ *
+ * Created: Jan 2022
+ * Author: Arjan te Marvelde
+ *
+ * See sched.c for more information 
+ */
+
+/* Events */
+#define SCHED_MON		0x01												// Monitor input available
+#define SCHED_HMI		0x02												// Keypad read or timer due
+#define SCHED_LCD		0x04												// Display changed or flush done
+#define SCHED_TICK		0x08												// Slow periodic tick
+#define SCHED_BOOT		0x10												// Deferred start-up, see uWFG.c
+
+/* Register handler fn for any of the events in mask, call during init */
+void sched_task(uint32_t mask, void (*fn)(void));
+
+/* Mark events as pending, may be called from IRQ on core 0 */
+void sched_post(uint32_t ev);
+
+/* Run handlers for pending events, sleep otherwise; never returns */
+void sched_run(void);
+
+#endif
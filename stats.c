@@ -0,0 +1,95 @@
+/*
+ * stats.c
+ *
+ * Created: Jan 2022
+ * Author: Arjan te Marvelde
+ *
+ * Runtime telemetry, to verify that a configuration runs without stalls.
+ *
+ * Channel status is sampled on each scheduler tick, and by the monitor stats command, see gen_hwstat():
+ * - The PIO FDEBUG.TXSTALL flag of the channel SM, which is set when the SM pulls from an empty TX FIFO. When the
+ *   DMA cannot keep up with the sample rate, e.g. due to bus conflicts with a short buffer, this flag gets set.
+ * - The TX FIFO level, a full FIFO means that the DMA is ahead.
+ * - The AHB_ERROR bits of the data and ctrl DMA channels, that halt the channel on a bus error.
+ * The dma_ctrl reloads are counted by gen_count() in a short window, this costs an interrupt per reload.
+ *
+ * The cycle cost of the probed functions is measured with the SysTick counter of the core it runs on.
+ * SysTick counts down from 2^24-1 at the system clock, so a probe must take less than 2^24 cycles, i.e. 134msec
+ * at 125MHz. Each core has its own SysTick, stats_init() is called on both.
+ * A display flush takes longer than that, so STATS_LCD is timed in usec with time_us_32() instead, see STATS_USEC.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+
+#include "gen.h"
+#include "stats.h"
+
+#define STATS_CSR		0x5													// SysTick enable, processor clock
+#define STATS_MASK		0x00ffffff											// 24 bit counter
+
+probe_t  stats_probe[STATS_NPROBE];
+chstat_t stats_ch[GEN_NCH];
+
+
+/*
+ * Run SysTick of the calling core from the system clock over its full 24 bit range
+ */
+void stats_init(void)
+{
+	systick_hw->csr = 0;
+	systick_hw->rvr = STATS_MASK;											// Full range
+	systick_hw->cvr = 0;													// Reload
+	systick_hw->csr = STATS_CSR;
+}
+
+/*
+ * Add the cycles since stats_begin() returned t0 to probe p
+ */
+void stats_end(int p, uint32_t t0)
+{
+	stats_add(p, stats_since(t0));
+}
+
+/*
+ * Add a measurement of dt to probe p, the unit is up to the caller: cycles, or usec for STATS_USEC probes
+ */
+void stats_add(int p, uint32_t dt)
+{
+	probe_t *pr = &stats_probe[p];
+
+	if ((pr->n == 0) || (dt < pr->min)) pr->min = dt;
+	if (dt > pr->max) pr->max = dt;
+	pr->sum += dt;
+	pr->n++;
+}
+
+/*
+ * Sample FIFO level, stalls and errors of the running channels, from the scheduler tick on core 0
+ */
+void stats_sample(void)
+{
+	chstat_t *cs;
+	int ch;
+
+	for (ch=0; ch<GEN_NCH; ch++)
+	{
+		cs = &stats_ch[ch];
+		if (!gen_hwstat(ch, &cs->hw)) continue;								// Channel not available
+		if (cs->hw.mode == GEN_IDLE) continue;
+		if ((cs->nsample == 0) || (cs->hw.level < cs->minlevel)) cs->minlevel = cs->hw.level;
+		if (cs->hw.stall) cs->nstall++;
+		if (cs->hw.err) cs->nerr++;
+		cs->nsample++;
+	}
+}
+
+/*
+ * Reset all probes and channel statistics
+ */
+void stats_clear(void)
+{
+	memset(stats_probe, 0, sizeof(stats_probe));
+	memset(stats_ch, 0, sizeof(stats_ch));
+}
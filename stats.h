@@ -0,0 +1,70 @@
+#ifndef __STATS_H__
+#define __STATS_H__
+/*
+ * stats.h
+ *
+ * Created: Jan 2022
+ * Author: Arjan te Marvelde
+ *
+ * See stats.c for more information
+ */
+
+#include "hardware/structs/systick.h"
+#include "gen.h"
+
+/* Cycle cost probes */
+#define STATS_PLAY		0													// gen_play(), on core 1
+#define STATS_GENWAVE	1													// core1_genwave(), on core 1
+#define STATS_LCD		2													// LCD transfer, DMA start to done, in usec
+#define STATS_USEC		(1u<<STATS_LCD)										// Probes timed in usec instead of cycles
+#define STATS_NPROBE	3
+
+#define STATS_WINDOW	100													// Reload counting window [msec]
+
+typedef struct
+{
+	uint32_t n;																// Nr of measurements
+	uint32_t min, max;														// Cycles, or usec see STATS_USEC
+	uint64_t sum;
+} probe_t;
+
+typedef struct
+{
+	genhw_t  hw;															// Last sample
+	uint32_t nsample;														// Nr of samples taken
+	uint32_t nstall;														// Nr of samples with a TX stall
+	uint32_t nerr;															// Nr of samples with a DMA error
+	uint32_t minlevel;														// Lowest TX FIFO level seen
+} chstat_t;
+
+extern probe_t  stats_probe[STATS_NPROBE];
+extern chstat_t stats_ch[GEN_NCH];
+
+/* Start the cycle counter of the calling core, call once on each core */
+void stats_init(void);
+
+/* Probe start, returns the cycle counter (counting down) */
+static inline uint32_t stats_begin(void)
+{
+	return systick_hw->cvr;
+}
+
+/* Cycles since probe start t0, modulo 2^24 */
+static inline uint32_t stats_since(uint32_t t0)
+{
+	return (t0 - systick_hw->cvr) & 0x00ffffff;								// Counting down
+}
+
+/* Probe end, adds the cycles since t0 to probe p */
+void stats_end(int p, uint32_t t0);
+
+/* Add a measurement of dt to probe p, for probes that are not timed with SysTick */
+void stats_add(int p, uint32_t dt);
+
+/* Sample the channel hardware status, run from the scheduler tick */
+void stats_sample(void);
+
+/* Clear all statistics */
+void stats_clear(void);
+
+#endif
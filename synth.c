@@ -0,0 +1,405 @@
+/*
+ * synth.c
+ *
+ * Created: Jan 2022
+ * Author: Arjan te Marvelde
+ * 
+ * Waveform synthesis kernels.
+ *
+ * The RP2040 has no FPU, so all per-sample calculations are done in integer arithmetic.
+ * Each waveform is composed of segments, which are generated by a kernel using a Q16.16 accumulator: 
+ * the integer part is the sample value (ramp) or the table index (table lookup), the step is added on every sample.
+ * The kernels write the bulk of the samples word-at-a-time, i.e. four samples per 32 bit store. 
+ * The Pico is little endian, so the first sample goes in the least significant byte.
+ * Only the unaligned head and tail of a segment are written bytewise.
+ *
+ * In 16 bit mode the samples are halfwords, two per 32 bit store. The ramp accumulator is then Q16.16 as well, 
+ * the integer part being the 16 bit sample.
+ *
+ * The sine is interpolated from a quarter wave table in flash, the other quarters follow from symmetry.
+ * This is accurate to about 1 LSB in 16 bit, and is used for the byte samples as well.
+ */
+
+#include <string.h>
+#include "pico/stdlib.h"
+
+#include "gen.h"
+#include "hmi.h"
+#include "synth.h"
+
+extern const uint16_t sine_q[257];											// Quarter sine wave magnitude
+
+#define Q16(x)		((uint32_t)(x)<<16)										// Integer to Q16.16
+
+
+/*
+ * Linear ramp of n samples, starting at acc and adding step for each next sample
+ * The sample is the integer part of acc, so it should remain within [0, 256).
+ */
+void synth_ramp(uint8_t *buf, uint32_t n, uint32_t acc, int32_t step)
+{
+	uint32_t w, *wp;
+	
+	while ((n>0) && ((uintptr_t)buf&3))										// Unaligned head
+	{
+		*buf++ = acc>>16; acc += step; n--;
+	}
+	wp = (uint32_t *)buf;
+	while (n>=4)															// Four samples per word
+	{
+		w  = (acc>>16);       acc += step;
+		w |= (acc>>16) <<  8; acc += step;
+		w |= (acc>>16) << 16; acc += step;
+		w |= (acc>>16) << 24; acc += step;
+		*wp++ = w; n -= 4;
+	}
+	buf = (uint8_t *)wp;
+	while (n>0)																// Tail
+	{
+		*buf++ = acc>>16; acc += step; n--;
+	}
+}
+
+/*
+ * Table lookup of n samples, the table index is the integer part of acc, step is added for each next sample
+ */
+void synth_table(uint8_t *buf, uint32_t n, const uint8_t *table, uint32_t acc, uint32_t step)
+{
+	uint32_t w, *wp;
+	
+	while ((n>0) && ((uintptr_t)buf&3))										// Unaligned head
+	{
+		*buf++ = table[acc>>16]; acc += step; n--;
+	}
+	wp = (uint32_t *)buf;
+	while (n>=4)															// Four samples per word
+	{
+		w  = table[acc>>16];       acc += step;
+		w |= table[acc>>16] <<  8; acc += step;
+		w |= table[acc>>16] << 16; acc += step;
+		w |= table[acc>>16] << 24; acc += step;
+		*wp++ = w; n -= 4;
+	}
+	buf = (uint8_t *)wp;
+	while (n>0)																// Tail
+	{
+		*buf++ = table[acc>>16]; acc += step; n--;
+	}
+}
+
+/*
+ * DDS lookup of n samples in a 256 entry table, the index is the top byte of the 32 bit phase accumulator
+ * The phase is updated, so consecutive calls give a continuous waveform.
+ */
+void synth_dds(uint8_t *buf, uint32_t n, const uint8_t *table, uint32_t *phase, uint32_t inc)
+{
+	uint32_t w, *wp, acc = *phase;
+	
+	while ((n>0) && ((uintptr_t)buf&3))										// Unaligned head
+	{
+		*buf++ = table[acc>>24]; acc += inc; n--;
+	}
+	wp = (uint32_t *)buf;
+	while (n>=4)															// Four samples per word
+	{
+		w  = table[acc>>24];       acc += inc;
+		w |= table[acc>>24] <<  8; acc += inc;
+		w |= table[acc>>24] << 16; acc += inc;
+		w |= table[acc>>24] << 24; acc += inc;
+		*wp++ = w; n -= 4;
+	}
+	buf = (uint8_t *)wp;
+	while (n>0)																// Tail
+	{
+		*buf++ = table[acc>>24]; acc += inc; n--;
+	}
+	*phase = acc;
+}
+
+/*
+ * Linear ramp of n 16 bit samples, the sample is the integer part of acc
+ */
+void synth_ramp16(uint16_t *buf, uint32_t n, uint32_t acc, int32_t step)
+{
+	uint32_t w, *wp;
+	
+	if ((n>0) && ((uintptr_t)buf&3))											// Unaligned head
+	{
+		*buf++ = acc>>16; acc += step; n--;
+	}
+	wp = (uint32_t *)buf;
+	while (n>=2)															// Two samples per word
+	{
+		w  = (acc>>16);       acc += step;
+		w |= (acc>>16) << 16; acc += step;
+		*wp++ = w; n -= 2;
+	}
+	buf = (uint16_t *)wp;
+	if (n>0)																// Tail
+		*buf = acc>>16;
+}
+
+/*
+ * Sine value at 32 bit phase acc, which is a full period, as a 16 bit sample
+ * Bits 29:22 of acc are the quarter table index, the next 16 bits interpolate between adjacent entries.
+ * The second and fourth quarter run backwards through the table, the third and fourth are below the midlevel.
+ */
+static inline uint16_t synth_sinval(uint32_t acc)
+{
+	uint32_t u = acc & 0x3fffffff;											// Phase within quarter
+	uint32_t i, f, m;
+	
+	if (acc & 0x40000000) u = 0x3fffffff - u;								// Falling quarter: mirror
+	i = u>>22; f = (u>>6)&0xffff;
+	m = sine_q[i] + (((sine_q[i+1]-sine_q[i])*f + 0x8000)>>16);				// Rounded, table is increasing
+	return (uint16_t)((acc & 0x80000000) ? (0x8000 - m) : (0x8000 + m));
+}
+
+/*
+ * Sine of n 16 bit samples, the 32 bit phase acc is a full period and step is added for each next sample
+ */
+void synth_sine16(uint16_t *buf, uint32_t n, uint32_t acc, uint32_t step)
+{
+	uint32_t w, *wp;
+	
+	if ((n>0) && ((uintptr_t)buf&3))											// Unaligned head
+	{
+		*buf++ = synth_sinval(acc); acc += step; n--;
+	}
+	wp = (uint32_t *)buf;
+	while (n>=2)															// Two samples per word
+	{
+		w  = synth_sinval(acc);       acc += step;
+		w |= synth_sinval(acc) << 16; acc += step;
+		*wp++ = w; n -= 2;
+	}
+	buf = (uint16_t *)wp;
+	if (n>0)																// Tail
+		*buf = synth_sinval(acc);
+}
+
+/*
+ * Sine of n byte samples, as synth_sine16() but only the top byte of each sample is taken
+ */
+void synth_sine(uint8_t *buf, uint32_t n, uint32_t acc, uint32_t step)
+{
+	uint32_t w, *wp;
+	
+	while ((n>0) && ((uintptr_t)buf&3))										// Unaligned head
+	{
+		*buf++ = synth_sinval(acc)>>8; acc += step; n--;
+	}
+	wp = (uint32_t *)buf;
+	while (n>=4)															// Four samples per word
+	{
+		w  = (synth_sinval(acc)>>8);       acc += step;
+		w |= (synth_sinval(acc)>>8) <<  8; acc += step;
+		w |= (synth_sinval(acc)>>8) << 16; acc += step;
+		w |= (synth_sinval(acc)>>8) << 24; acc += step;
+		*wp++ = w; n -= 4;
+	}
+	buf = (uint8_t *)wp;
+	while (n>0)																// Tail
+	{
+		*buf++ = synth_sinval(acc)>>8; acc += step; n--;
+	}
+}
+
+/*
+ * Sine value at 32 bit phase acc as a signed Q15 number, for use outside the kernels
+ */
+int32_t synth_sin(uint32_t acc)
+{
+	return (int32_t)synth_sinval(acc) - 0x8000;
+}
+
+/*
+ * Scale n byte samples from src into dst around the midlevel, with gain g in 1/256: dst = 128 + (src-128)*g/256
+ * The gain is applied to four samples per word, SWAR style: the even and odd bytes are multiplied in two 16 bit
+ * lanes each, which cannot overflow for g <= 256. The offset (256-g)/2 moves the result back to the midlevel.
+ * Both buffers must be word aligned, and n a multiple of 4.
+ */
+void synth_scale(uint8_t *dst, const uint8_t *src, uint32_t n, uint32_t g)
+{
+	const uint32_t *sp = (const uint32_t *)src;
+	uint32_t *dp = (uint32_t *)dst;
+	uint32_t w, o;
+
+	if (g > 256) g = 256;
+	o = ((256 - g)>>1) * 0x01010101;										// Offset in each byte
+	for (n>>=2; n>0; n--)
+	{
+		w = *sp++;
+		*dp++ = ((((w & 0x00ff00ff) * g) >> 8) & 0x00ff00ff)				// Even bytes
+			  + ((((w >> 8) & 0x00ff00ff) * g) & 0xff00ff00)				// Odd bytes
+			  + o;
+	}
+}
+
+/*
+ * Map n byte samples from src through a 256 entry table into dst, in place when dst is src
+ * Word parallel: one load and one store per four samples, the four lookups are merged into the stored word.
+ * Unaligned buffers or a length that is no multiple of 4 are done byte by byte.
+ */
+void synth_lut(uint8_t *dst, const uint8_t *src, uint32_t n, const uint8_t *lut)
+{
+	const uint32_t *sp = (const uint32_t *)src;
+	uint32_t *dp = (uint32_t *)dst;
+	uint32_t w;
+
+	if ((((uintptr_t)dst | (uintptr_t)src | n) & 3) != 0)
+	{
+		while (n--) *dst++ = lut[*src++];
+		return;
+	}
+	for (n>>=2; n>0; n--)
+	{
+		w = *sp++;
+		*dp++ = (uint32_t)lut[w & 0xff]
+			  | ((uint32_t)lut[(w >> 8) & 0xff] << 8)
+			  | ((uint32_t)lut[(w >> 16) & 0xff] << 16)
+			  | ((uint32_t)lut[w >> 24] << 24);
+	}
+}
+
+/*
+ * Rising (n samples from 0x00) or falling (n samples from 0xff) flank
+ * A falling flank mirrors the rising one, hence the start at 0xff.ffff
+ */
+static void synth_rise(uint8_t *buf, uint32_t n)
+{
+	if (n>0) synth_ramp(buf, n, 0, Q16(255)/n);
+}
+static void synth_fall(uint8_t *buf, uint32_t n)
+{
+	if (n>0) synth_ramp(buf, n, Q16(255)|0xffff, -(int32_t)(Q16(255)/n));
+}
+static void synth_rise16(uint16_t *buf, uint32_t n)
+{
+	if (n>0) synth_ramp16(buf, n, 0, (int32_t)(Q16(65535)/n));
+}
+static void synth_fall16(uint16_t *buf, uint32_t n)
+{
+	if (n>0) synth_ramp16(buf, n, 0xffffffff, -(int32_t)(Q16(65535)/n));
+}
+
+/*
+ * Fill waveform with definition def in 16 bit samples, n samples
+ * Constant levels are 0x0000 or 0xffff, so memset can still be used.
+ */
+static void synth_wave16(ch_t *def, uint16_t *buf, uint32_t n)
+{
+	uint32_t d, r, f;
+
+	switch (def->mode)
+	{
+	case HMI_SQR:
+		memset(&buf[0], 0xff, 2*(n/2)); 									// High half samples
+		memset(&buf[n/2], 0x00, 2*(n-n/2));									// Low half samples
+		break;
+	case HMI_TRI:
+		synth_rise16(&buf[0], n/2);											// Samples way up
+		synth_fall16(&buf[n/2], n-n/2);										// Samples way down
+		break;
+	case HMI_SAW:
+		synth_rise16(&buf[0], n);											// Samples rising side
+		break;
+	case HMI_SIN:
+		synth_sine16(buf, n, 0, (uint32_t)(0x100000000ULL/n));				// One period
+		break;
+	case HMI_PUL:
+		d = def->duty * n / 100;											// Fraction of duty cycle samples
+		r = def->rise * n / 100;											// Fraction of rising flank samples
+		f = def->fall * n / 100;											// Fraction of falling flank samples
+		if (r>d) r = d;														// Rising flank within duty cycle
+		if (f>n-d) f = n-d;													// Falling flank within remainder
+		synth_rise16(&buf[0], r);											// Samples way up
+		memset(&buf[r], 0xff, 2*(d-r));										// High samples
+		synth_fall16(&buf[d], f);											// Samples way down
+		memset(&buf[d+f], 0x00, 2*(n-d-f));									// Low samples
+		break;
+	}
+}
+
+/*
+ * Fill waveform with definition def in byte samples, n samples
+ */
+static void synth_wave8(ch_t *def, uint8_t *buf, uint32_t n)
+{
+	uint32_t d, r, f;
+
+	switch (def->mode)
+	{
+	case HMI_SQR:
+		memset(&buf[0], 0xff, n/2); 										// High half samples
+		memset(&buf[n/2], 0x00, n-n/2);										// Low half samples
+		break;
+	case HMI_TRI:
+		synth_rise(&buf[0], n/2);											// Samples way up
+		synth_fall(&buf[n/2], n-n/2);										// Samples way down
+		break;
+	case HMI_SAW:
+		synth_rise(&buf[0], n);												// Samples rising side
+		break;
+	case HMI_SIN:
+		synth_sine(buf, n, 0, (uint32_t)(0x100000000ULL/n));				// One period
+		break;
+	case HMI_PUL:
+		d = def->duty * n / 100;											// Fraction of duty cycle samples
+		r = def->rise * n / 100;											// Fraction of rising flank samples
+		f = def->fall * n / 100;											// Fraction of falling flank samples
+		if (r>d) r = d;														// Rising flank within duty cycle
+		if (f>n-d) f = n-d;													// Falling flank within remainder
+		synth_rise(&buf[0], r);												// Samples way up
+		memset(&buf[r], 0xff, d-r);											// High samples
+		synth_fall(&buf[d], f);												// Samples way down
+		memset(&buf[d+f], 0x00, n-d-f);										// Low samples
+		break;
+	}
+}
+
+// Generate waveform samples in buffer
+// Division factor should end-up above 4 to get a <0.1% deviation
+// so: fsample < fsys/4, implying a bufferlength of maximum time*fsys/4.
+// This is about 50 samples per usec, but this length should be minimized too
+// which means that for times smaller than a few usec the frequency will be less accurate.
+// Simple waveforms can be calculated, for Sine wave there is a lookup-table
+// See synth_plan() for exact frequencies.
+void synth_wave(ch_t *def, wfg_t *wf)
+{
+	uint32_t len;
+	int wid = gen_getwidth();												// Bytes per sample
+	
+	// Calculate optimum nr of samples
+	len = (uint32_t)(_fsys * def->time) * wid;								// Calculate required nr of bytes
+	len &= ~3;																// Multiple of 4 bytes
+	if (len<GEN_MINBUFLEN) len = GEN_MINBUFLEN;								// Minimum size
+	if (len>gen_maxlen()) len = gen_maxlen();								// Maximum size
+	
+	if (wid == GEN_WIDTH16)
+		synth_wave16(def, (uint16_t *)wf->buf, len/2);
+	else
+		synth_wave8(def, wf->buf, len);
+	wf->len = len;
+	wf->dur = def->time;
+}
+
+/*
+ * Generate waveform samples in buffer according to a frequency plan, see plan.c
+ * One period of pl->k samples is synthesized, and copied until the buffer holds pl->per periods.
+ */
+void synth_plan(ch_t *def, wfg_t *wf, plan_t *pl)
+{
+	uint32_t i, plen;
+	int wid = gen_getwidth();												// Bytes per sample
+
+	if (wid == GEN_WIDTH16)
+		synth_wave16(def, (uint16_t *)wf->buf, pl->k);
+	else
+		synth_wave8(def, wf->buf, pl->k);
+	plen = pl->k * wid;														// Period length in bytes
+	for (i=1; i<pl->per; i++)
+		memcpy(&wf->buf[i*plen], wf->buf, plen);
+	wf->len = pl->n * wid;
+	wf->dur = plan_dur(pl);
+}
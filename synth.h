@@ -0,0 +1,35 @@
+#ifndef __SYNTH_H__
+#define __SYNTH_H__
+/* 
+ * synth.h
+ *
+ * Created: Jan 2022
+ * Author: Arjan te Marvelde
+ *
+ * See synth.c for more information 
+ */
+
+#include "gen.h"
+#include "hmi.h"
+#include "plan.h"
+
+/* Kernels, fill n byte samples */
+void synth_ramp(uint8_t *buf, uint32_t n, uint32_t acc, int32_t step);
+void synth_table(uint8_t *buf, uint32_t n, const uint8_t *table, uint32_t acc, uint32_t step);
+void synth_dds(uint8_t *buf, uint32_t n, const uint8_t *table, uint32_t *phase, uint32_t inc);
+void synth_sine(uint8_t *buf, uint32_t n, uint32_t acc, uint32_t step);
+void synth_scale(uint8_t *dst, const uint8_t *src, uint32_t n, uint32_t g);
+void synth_lut(uint8_t *dst, const uint8_t *src, uint32_t n, const uint8_t *lut);
+int32_t synth_sin(uint32_t acc);											// Signed Q15 sine at phase acc
+
+/* 16 bit kernels, fill n halfword samples */
+void synth_ramp16(uint16_t *buf, uint32_t n, uint32_t acc, int32_t step);
+void synth_sine16(uint16_t *buf, uint32_t n, uint32_t acc, uint32_t step);
+
+/* Synthesize waveform with definition def into wf->buf, sets wf->len and wf->dur, sample width follows gen_getwidth() */
+void synth_wave(ch_t *def, wfg_t *wf);
+
+/* Synthesize waveform with definition def according to frequency plan pl */
+void synth_plan(ch_t *def, wfg_t *wf, plan_t *pl);
+
+#endif
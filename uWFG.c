@@ -6,6 +6,10 @@
  * 
  * The main loop of the application.
  * 
+ * Start-up is done in phases, so the output is valid within a few msec of reset:
+ * 1. Clock, generator and core 1, with the boot preset
+ * 2. LED, I2C, keypad and display initialization, without waiting for transfers
+ * 3. Scheduler, which sends the first display frame by DMA and then starts USB (boot_evaluate())
  */
 
 #include <stdio.h>
@@ -24,6 +28,11 @@
 #include "monitor.h"
 #include "hmi.h"
 #include "lcd.h"
+#include "core1.h"
+#include "lcr.h"
+#include "sched.h"
+#include "stats.h"
+#include "preset.h"
 
 #define I2C0_SDA		16
 #define I2C0_SCL		17
@@ -42,22 +51,40 @@ bool led_callback(struct repeating_timer *t)
 }
 
 /*
- * Scheduler timer callback function.
- * This executes every LOOP_MS msec.
+ * Slow tick, as fallback for missed events
  */
-#define LOOP_MS		100
-semaphore_t loop_sem;
-struct repeating_timer loop_timer;
-bool loop_callback(struct repeating_timer *t)
+#define TICK_MS		1000
+struct repeating_timer tick_timer;
+bool tick_callback(struct repeating_timer *t)
 {
-	sem_reset(&loop_sem, 1);
+	sched_post(SCHED_TICK);
 	return(true);
 }
 
+/*
+ * USB CDC receive callback
+ */
+void mon_rxcallback(void *param)
+{
+	sched_post(SCHED_MON);
+}
+
+/*
+ * Deferred start-up, run by the scheduler on the SCHED_BOOT posted by main()
+ * Enumeration of the USB device takes long, this way it does not delay the output or the display.
+ */
+void boot_evaluate(void)
+{
+	mon_init();																// Monitor shell on stdio
+	stdio_set_chars_available_callback(mon_rxcallback, NULL);
+	sched_post(SCHED_MON);
+}
 
 int main()
 {
-	/* Overclock by factor 2 */
+	/* Phase 1: output, within a few msec of reset */
+
+	/* Default system clock, see the monitor clock command for overclocking */
 	set_sys_clock_khz(125000, false);
 	sleep_ms(2);
 	
@@ -66,6 +93,14 @@ int main()
 	gpio_set_dir(23, GPIO_OUT);
 	gpio_put(23, true);														// Set PWM mode for less ripple
 
+	stats_init();															// Cycle counter of core 0
+	preset_init();															// Boot preset samples for gen_init()
+	gen_init();
+	core1_init();															// Generator service on core 1
+	preset_load(PRESET_BOOT);												// Rest of the boot preset
+
+	/* Phase 2: user interface, without waiting for I/O */
+
 	/* Initialize LED pin output */
 	gpio_init(PICO_DEFAULT_LED_PIN);
 	gpio_set_dir(PICO_DEFAULT_LED_PIN, GPIO_OUT);
@@ -79,20 +114,19 @@ int main()
 	gpio_pull_up(I2C0_SDA);
 	gpio_pull_up(I2C0_SCL);
 
-	gen_init();
-	lcd_init();
+	lcr_init();																// ADC capture for LCR meter
+	lcd_init();																// Frame is sent by lcd_flush()
 	hmi_init();
-	mon_init();																// Monitor shell on stdio
 		
-	/* A simple round-robin scheduler */
-	sem_init(&loop_sem, 1, 1) ;	
-	add_repeating_timer_ms(-LOOP_MS, loop_callback, NULL, &loop_timer);		// Run every LOOP_MS
-	while (1) 										
-	{
-		sem_acquire_blocking(&loop_sem);
-		mon_evaluate();														// Check monitor input
-		hmi_evaluate();
-	}
+	/* Phase 3: event driven scheduler, also runs the display flush and the USB start-up */
+	sched_task(SCHED_MON|SCHED_TICK, mon_evaluate);							// Monitor input
+	sched_task(SCHED_HMI|SCHED_TICK, hmi_evaluate);							// Keypad events
+	sched_task(SCHED_LCD|SCHED_TICK, lcd_flush);							// Display changes
+	sched_task(SCHED_TICK, stats_sample);									// Channel telemetry
+	sched_task(SCHED_BOOT, boot_evaluate);									// Last, after the first flush started
+	add_repeating_timer_ms(-TICK_MS, tick_callback, NULL, &tick_timer);
+	sched_post(SCHED_HMI|SCHED_LCD|SCHED_BOOT);								// Initial run
+	sched_run();															// Never returns
 
     return 0;
-}
+}
\ No newline at end of file
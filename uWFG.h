@@ -9,11 +9,9 @@
  * See uWFG.c and waveform.c for more information 
  */
 
-extern uint8_t sine16[16];
-extern uint8_t sine64[64];
-extern uint8_t sine256[256];
-extern uint8_t saw256[256];
-extern uint8_t block16[16];
+extern const uint16_t sine_q[257];											// Quarter sine, see synth_sinval()
+extern const uint8_t sine256[256];											// DDS tables
+extern const uint8_t saw256[256];
 
 
 #endif
\ No newline at end of file